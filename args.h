@@ -7,21 +7,32 @@
 #ifndef UTILS_ARGS_H_
 #define UTILS_ARGS_H_
 
+#include "utils/logger.h"
+#include "utils/stringpool.h"
 #include "utils/stringutils.h"
+#include "utils/typedcache.h"
 
 #include <algorithm>
+#include <array>
 #include <cctype>
 #include <cstddef>
+#include <deque>
+#include <functional>
 #include <iomanip>
 #include <iostream>
-#include <sstream>
+#include <memory>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
-// NOLINTNEXTLINE
-#include <getopt.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 namespace utils {
 
@@ -30,15 +41,36 @@ namespace utils {
  * @todo comment functions
  */
 class Args {
+  public:
+  enum Argument { Required = 1, No = 0, Optional = 2 };
+
   private:
   struct OptionInfo {
     /** Leave empty if this not an enum option */
     std::vector<std::string> enumValues;
-    std::string longOption; // We need a copy here to get the const char* correct
+    std::string longOption;
+    InternedString name;
     /** Name of the value in the help command */
     std::string value;
     std::string description;
+    Argument argument;
+    /** 0 if the option has no short form */
+    char shortOption;
     bool required;
+    /** True if all values of the option are collected */
+    bool list;
+    /** Separates several values of a list option (0 if values are not split) */
+    char delimiter;
+  };
+
+  struct SubcommandInfo {
+    std::string name;
+    std::string description;
+    std::function<void(Args&)> setup;
+    /** Constructed when the subcommand is selected for the first time */
+    std::unique_ptr<Args> args;
+    /** Program name used in messages of the subcommand */
+    std::string prog;
   };
 
   struct AdditionalOptionInfo {
@@ -47,6 +79,65 @@ class Args {
     bool required;
   };
 
+  /**
+   * A read-only file mapped into memory
+   *
+   * Falls back to reading the file if it cannot be mapped (e.g. for pipes).
+   */
+  class MappedFile {
+    private:
+    const char* m_data{nullptr};
+    std::size_t m_size{0};
+    bool m_mapped{false};
+    bool m_valid{false};
+    std::string m_content;
+
+    public:
+    explicit MappedFile(const std::string& filename) {
+      const int fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+      if (fd < 0) {
+        return;
+      }
+
+      struct stat st {};
+      if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+          m_data = static_cast<const char*>(data);
+          m_size = st.st_size;
+          m_mapped = true;
+          m_valid = true;
+        }
+      }
+
+      if (!m_mapped) {
+        char buffer[4096];
+        ssize_t n = 0;
+        while ((n = read(fd, buffer, sizeof(buffer))) > 0) {
+          m_content.append(buffer, n);
+        }
+        m_data = m_content.data();
+        m_size = m_content.size();
+        m_valid = n == 0;
+      }
+
+      close(fd);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    auto operator=(const MappedFile&) -> MappedFile& = delete;
+
+    ~MappedFile() {
+      if (m_mapped) {
+        munmap(const_cast<char*>(m_data), m_size);
+      }
+    }
+
+    [[nodiscard]] auto valid() const -> bool { return m_valid; }
+
+    [[nodiscard]] auto view() const -> std::string_view { return {m_data, m_size}; }
+  };
+
   /**
    * Convert a long option into an "argument" that is shown in the help message
    */
@@ -61,39 +152,82 @@ class Args {
     }
   };
 
+  /** Returned by findLongOption() */
+  static constexpr std::size_t UnknownOption = static_cast<std::size_t>(-1);
+
   /** Program description (can be empty) */
   const std::string mDescription;
   /** Automatically add help option */
   const bool mAddHelp;
 
-  /** The command line arguments */
-  std::vector<struct option> m_options;
-  /**
-   * Additional information for the command line arguments
-   * required to generate help information
-   */
+  /** The command line options */
   std::vector<OptionInfo> m_optionInfo;
 
   std::vector<AdditionalOptionInfo> m_additionalOptionInfo;
 
-  /** Maps from short option to index in m_options */
-  std::unordered_map<char, size_t> m_short2option;
+  /** Maps from short option to index + 1 in m_optionInfo (0 if the short option is unused) */
+  std::array<std::size_t, 256> m_shortOptions{};
+
+  /**
+   * Indices in m_optionInfo sorted by the long option
+   *
+   * Rebuilt by parse() if options were added since the last call.
+   */
+  std::vector<std::size_t> m_longOptions;
+
+  std::vector<SubcommandInfo> m_subcommands;
+
+  /** Index of the subcommand selected by parse() */
+  std::optional<std::size_t> m_selectedSubcommand;
+
+  /** True if the help option was already added */
+  bool m_helpAdded{false};
+
+  /** Expand arguments starting with '@' */
+  bool m_responseFiles{false};
 
-  /** Contains the arguments after parse was called */
-  std::unordered_map<std::string, std::string> m_arguments;
+  /** Index of the option that reads a config file (or UnknownOption) */
+  std::size_t m_configOption{UnknownOption};
+
+  /** Copy of the command line (null separated) */
+  std::string m_commandLine;
+
+  /** Response and config files used by the last parse() */
+  std::vector<std::unique_ptr<MappedFile>> m_files;
+
+  /** Number of files currently read (to detect recursion) */
+  unsigned int m_fileDepth{0};
+
+  /** Values that do not exist in m_commandLine or in m_files */
+  std::deque<std::string> m_ownedValues;
+
+  /**
+   * Contains the arguments after parse was called
+   *
+   * The values point into m_commandLine, m_files or m_ownedValues.
+   */
+  std::unordered_map<InternedString, std::string_view> m_arguments;
+
+  /** All values of list options after parse was called */
+  std::unordered_map<InternedString, std::vector<std::string_view>> m_listArguments;
 
   /**
    * Contains additional arguments after parse was called
    * @todo Find a better name
    */
-  std::unordered_map<std::string, std::string> m_additionalArguments;
+  std::unordered_map<InternedString, std::string_view> m_additionalArguments;
+
+  /** Parsed values of m_arguments and m_additionalArguments */
+  TypedCache m_parsedArguments;
+  TypedCache m_parsedAdditionalArguments;
 
   /** Additional user-defined help message */
   std::string m_customHelpMessage;
 
-  public:
-  enum Argument { Required = required_argument, No = no_argument, Optional = optional_argument };
+  /** Maximum nesting of response and config files */
+  static constexpr unsigned int MaxFileDepth = 16;
 
+  public:
   enum Result {
     Success = 0,
     Error,
@@ -153,148 +287,185 @@ class Args {
     m_additionalOptionInfo.push_back(i);
   }
 
+  /**
+   * Adds an option that can be given several times
+   *
+   * The values of all occurrences are collected in order and split at the
+   * delimiter, e.g. "--receivers 1.5,2 --receivers 3" results in {1.5, 2, 3}.
+   * Use getList() to get the values.
+   *
+   * @param delimiter Use 0 to collect the values without splitting them
+   */
+  void addListOption(const std::string& longOption,
+                     char shortOption,
+                     const std::string& description,
+                     char delimiter = ',',
+                     bool required = false) {
+    std::string value = longOption;
+    std::for_each(value.begin(), value.end(), ValueConvert());
+    if (delimiter != 0) {
+      value += std::string("[") + delimiter + "...]";
+    }
+
+    addOptionInternal(longOption, shortOption, description, Required, required, value);
+    m_optionInfo.back().list = true;
+    m_optionInfo.back().delimiter = delimiter;
+  }
+
+  /**
+   * Adds an option that reads options from a file
+   *
+   * Each line of the file contains <code>name = value</code> or only
+   * <code>name</code> for options without a value. Empty lines and lines
+   * starting with '#' are ignored. Reading the file has the same effect as
+   * passing <code>--name=value</code> at the position of the option, i.e.
+   * later options on the command line override values from the file.
+   */
+  void addConfigOption(const std::string& longOption = "config",
+                       char shortOption = 0,
+                       const std::string& description = "Read options from a file") {
+    m_configOption = m_optionInfo.size();
+    addOptionInternal(longOption, shortOption, description, Required, false, "FILE");
+  }
+
+  /**
+   * Replace arguments of the form <code>@file</code> with the content of the file
+   *
+   * The file contains arguments separated by white space. Single and double
+   * quotes group arguments with white space, a backslash escapes the next
+   * character and '#' at the beginning of an argument starts a comment. Files
+   * can include other files.
+   */
+  void enableResponseFiles(bool enable = true) { m_responseFiles = enable; }
+
   /**
    * Set a help message that is added to the parameter explanation
    */
   void setCustomHelpMessage(const std::string& message) { m_customHelpMessage = message; }
 
   /**
+   * Parses the command line
+   *
+   * Can be called several times (with the same or different arguments). Long
+   * options can be abbreviated as long as the prefix is unique. Positional
+   * arguments can appear between options; everything after "--" is treated as
+   * positional argument.
+   *
+   * If subcommands are added, the first positional argument selects the
+   * subcommand and all following arguments are parsed by the subcommand.
+   *
    * @return True of options are successfully parsed, false otherwise
    */
   auto parse(int argc, char* const* argv, bool printHelp = true) -> Result {
-    if (mAddHelp) {
-      addOption("help", 'h', "Show this help message", No, false);
-    }
+    startParse();
 
-    std::ostringstream shortOptions;
-    for (const auto& option : m_options) {
-      if (option.val != 0) {
-        shortOptions << static_cast<char>(option.val);
-        switch (option.has_arg) {
-        case required_argument:
-          shortOptions << ':';
-          break;
-        case optional_argument:
-          shortOptions << "::";
-          break;
-        }
-      }
-    }
-
-    // Add null option
-    struct option const o = {nullptr, 0, nullptr, 0};
-    m_options.push_back(o);
-
-    // Update const char* in m_options
-    for (size_t i = 0; i < m_optionInfo.size(); i++) {
-      m_options[i].name = m_optionInfo[i].longOption.c_str();
+    // Copy the command line once, values only point into this copy
+    std::size_t length = 0;
+    for (int i = 1; i < argc; i++) {
+      length += std::char_traits<char>::length(argv[i]) + 1;
     }
-
-    while (true) {
-      int optionIndex = 0;
-
-      const int c =
-          getopt_long(argc, argv, shortOptions.str().c_str(), m_options.data(), &optionIndex);
-
-      if (c < 0) {
-        break;
-      }
-
-      switch (c) {
-      case '?':
-        if (printHelp) {
-          helpMessage(argv[0], std::cerr);
-        }
-        return Error;
-      case 0:
-        // Nothing to do
-        break;
-      default:
-        optionIndex = m_short2option.at(c);
-      }
-
-      if (optarg == nullptr) {
-        m_arguments[m_options[optionIndex].name] = "";
-      } else {
-        m_arguments[m_options[optionIndex].name] = optarg;
-      }
-
-      if (!m_optionInfo[optionIndex].enumValues.empty()) {
-        const auto i = std::find(m_optionInfo[optionIndex].enumValues.begin(),
-                                 m_optionInfo[optionIndex].enumValues.end(),
-                                 m_arguments[m_options[optionIndex].name]);
-        if (i == m_optionInfo[optionIndex].enumValues.end()) {
+    m_commandLine.clear();
+    m_commandLine.reserve(length);
+    std::vector<std::string_view> arguments;
+    arguments.reserve(argc);
+    for (int i = 1; i < argc; i++) {
+      const std::size_t offset = m_commandLine.size();
+      m_commandLine.append(argv[i]).push_back('\0');
+      const std::string_view arg(m_commandLine.data() + offset, m_commandLine.size() - offset - 1);
+      if (m_responseFiles && arg.size() > 1 && arg[0] == '@') {
+        if (!readResponseFile(arg.substr(1), arguments, argv[0], printHelp)) {
           if (printHelp) {
-            std::cerr << argv[0] << ": option --" << m_options[optionIndex].name
-                      << " must be set to " << m_optionInfo[optionIndex].value << '\n';
             helpMessage(argv[0], std::cerr);
           }
           return Error;
         }
-
-        m_arguments[m_options[optionIndex].name] =
-            StringUtils::toString(i - m_optionInfo[optionIndex].enumValues.begin());
+      } else {
+        arguments.push_back(arg);
       }
     }
 
-    if (mAddHelp && isSet("help")) {
-      if (printHelp) {
-        helpMessage(argv[0]);
-      }
-      return Help;
-    }
+    return parseArguments(arguments, argv[0], printHelp);
+  }
 
-    for (const auto& info : m_optionInfo) {
-      if (info.required && !isSet(info.longOption)) {
-        if (printHelp) {
-          std::cerr << argv[0] << ": option --" << info.longOption << " is required" << '\n';
-          helpMessage(argv[0], std::cerr);
-        }
-        return Error;
-      }
-    }
+  /**
+   * Adds a subcommand (e.g. "convert" in "prog --verbose convert input.h5")
+   *
+   * The parser of the subcommand is only constructed (and setup is only
+   * called) if the subcommand is selected on the command line. Use
+   * "prog command --help" to show the help message of the subcommand.
+   * Additional options of this parser are ignored once subcommands are
+   * added.
+   *
+   * @param setup Adds the options of the subcommand
+   */
+  void addSubcommand(const std::string& name,
+                     const std::string& description,
+                     std::function<void(Args&)> setup) {
+    m_subcommands.push_back({name, description, std::move(setup), nullptr, ""});
+  }
 
-    // Parse additional options and check if all required options are set
-    int i = 0;
-    for (i = 0; i < argc - optind; i++) {
-      if (i >= static_cast<int>(m_additionalOptionInfo.size())) {
-        if (printHelp) {
-          std::cerr << argv[0] << ": ignoring unknown parameter \"" << argv[i + optind] << "\""
-                    << '\n';
-        }
-      } else {
-        m_additionalArguments[m_additionalOptionInfo[i].name] = argv[i + optind];
-      }
+  /**
+   * @return The selected subcommand or an empty string if there is none
+   */
+  [[nodiscard]] auto subcommand() const -> std::string_view {
+    if (!m_selectedSubcommand.has_value()) {
+      return {};
     }
-    if (static_cast<size_t>(i) < m_additionalOptionInfo.size()) {
-      if (m_additionalOptionInfo[i].required) {
-        if (printHelp) {
-          std::cerr << argv[0] << ": option <" << m_additionalOptionInfo[i].name << "> is required"
-                    << '\n';
-          helpMessage(argv[0], std::cerr);
-        }
-        return Error;
-      }
+    return m_subcommands[m_selectedSubcommand.value()].name;
+  }
+
+  /**
+   * @return The parser of the selected subcommand
+   */
+  auto subcommandArgs() -> Args& {
+    if (!m_selectedSubcommand.has_value()) {
+      logError() << "No subcommand selected";
     }
+    return *m_subcommands[m_selectedSubcommand.value()].args;
+  }
 
-    return Success;
+  auto isSet(std::string_view option) const -> bool {
+    // Options that were never interned cannot be set
+    const auto name = StringPool::global().find(option);
+    return name.has_value() && isSet(name.value());
   }
 
-  auto isSet(const std::string& option) const -> bool {
+  auto isSet(InternedString option) const -> bool {
     return m_arguments.find(option) != m_arguments.end();
   }
 
-  auto isSetAdditional(const std::string& option) const -> bool {
+  auto isSetAdditional(std::string_view option) const -> bool {
+    const auto name = StringPool::global().find(option);
+    return name.has_value() && isSetAdditional(name.value());
+  }
+
+  auto isSetAdditional(InternedString option) const -> bool {
     return m_additionalArguments.find(option) != m_additionalArguments.end();
   }
 
   template <typename T>
-  auto getArgument(const std::string& option) -> T {
-    return StringUtils::parse<T>(m_arguments.at(option));
+  auto getArgument(std::string_view option) -> T {
+    return getArgument<T>(intern(option));
+  }
+
+  /**
+   * Same as getArgument(std::string_view) but the lookup only compares the id
+   *
+   * The value is parsed on the first call and cached afterwards.
+   */
+  template <typename T>
+  auto getArgument(InternedString option) -> T {
+    return m_parsedArguments.get<T>(
+        option, [this, option]() { return parseValue<T>(m_arguments.at(option)); });
+  }
+
+  template <typename T>
+  auto getArgument(std::string_view option, T defaultArgument) -> T {
+    return getArgument<T>(intern(option), defaultArgument);
   }
 
   template <typename T>
-  auto getArgument(const std::string& option, T defaultArgument) -> T {
+  auto getArgument(InternedString option, T defaultArgument) -> T {
     if (!isSet(option)) {
       return defaultArgument;
     }
@@ -303,12 +474,24 @@ class Args {
   }
 
   template <typename T>
-  auto getAdditionalArgument(const std::string& option) -> T {
-    return StringUtils::parse<T>(m_additionalArguments.at(option));
+  auto getAdditionalArgument(std::string_view option) -> T {
+    return getAdditionalArgument<T>(intern(option));
   }
 
   template <typename T>
-  auto getAdditionalArgument(const std::string& option, T defaultArgument) -> T {
+  auto getAdditionalArgument(InternedString option) -> T {
+    return m_parsedAdditionalArguments.get<T>(option, [this, option]() {
+      return parseValue<T>(m_additionalArguments.at(option));
+    });
+  }
+
+  template <typename T>
+  auto getAdditionalArgument(std::string_view option, T defaultArgument) -> T {
+    return getAdditionalArgument<T>(intern(option), defaultArgument);
+  }
+
+  template <typename T>
+  auto getAdditionalArgument(InternedString option, T defaultArgument) -> T {
     if (!isSetAdditional(option)) {
       return defaultArgument;
     }
@@ -316,20 +499,57 @@ class Args {
     return getAdditionalArgument<T>(option);
   }
 
+  template <typename T>
+  auto getList(std::string_view option) -> const std::vector<T>& {
+    return getList<T>(intern(option));
+  }
+
+  /**
+   * @return All values of a list option (empty if the option is not set)
+   *
+   * The values are parsed on the first call. The reference is valid until
+   * parse() is called again. With <code>T = std::string_view</code> the
+   * values are not copied.
+   */
+  template <typename T>
+  auto getList(InternedString option) -> const std::vector<T>& {
+    return m_parsedArguments.get<std::vector<T>>(option, [this, option]() {
+      std::vector<T> values;
+      const auto it = m_listArguments.find(option);
+      if (it != m_listArguments.end()) {
+        values.reserve(it->second.size());
+        for (const std::string_view value : it->second) {
+          values.push_back(parseValue<T>(value));
+        }
+      }
+      return values;
+    });
+  }
+
+  /**
+   * Resolves an option once (after parse() was called)
+   *
+   * The binding is not updated if parse() is called again.
+   */
+  template <typename T>
+  auto bind(std::string_view option, T defaultArgument) -> Binding<T> {
+    return Binding<T>(getArgument<T>(option, std::move(defaultArgument)));
+  }
+
   void helpMessage(const char* prog, std::ostream& out = std::cout) {
     // First line with all short options
     out << "Usage: " << prog;
-    for (size_t i = 0; i < m_options.size() - 1; i++) {
+    for (size_t i = 0; i < m_optionInfo.size(); i++) {
       out << ' ';
 
       if (!m_optionInfo[i].required) {
         out << '[';
       }
 
-      if (m_options[i].val != 0) {
-        out << '-' << static_cast<char>(m_options[i].val);
+      if (m_optionInfo[i].shortOption != 0) {
+        out << '-' << m_optionInfo[i].shortOption;
       } else {
-        out << "--" << m_options[i].name;
+        out << "--" << m_optionInfo[i].longOption;
       }
 
       argumentInfo(i, out);
@@ -351,6 +571,9 @@ class Args {
         out << ']';
       }
     }
+    if (!m_subcommands.empty()) {
+      out << " <command> [<args>]";
+    }
     out << '\n';
 
     // General program description
@@ -378,22 +601,42 @@ class Args {
       }
     }
 
+    // Subcommands (without constructing their parsers)
+    if (!m_subcommands.empty()) {
+      out << '\n' << "commands:" << '\n';
+      for (const auto& sub : m_subcommands) {
+        out << "  " << sub.name;
+
+        // Number of characters used for the command
+        const size_t length = 2 + sub.name.size();
+
+        if (length >= 30) {
+          out << '\n';
+          out << std::setw(30) << ' ';
+        } else {
+          out << std::setw(30 - length) << ' ';
+        }
+
+        out << sub.description << '\n';
+      }
+    }
+
     // Optional arguments
-    if (m_options.size() > 1) {
+    if (!m_optionInfo.empty()) {
       out << '\n' << "optional arguments:" << '\n';
-      for (size_t i = 0; i < m_options.size() - 1; i++) {
+      for (size_t i = 0; i < m_optionInfo.size(); i++) {
         out << "  ";
 
         // Number of characters used for the option
         size_t length = 2;
 
-        if (m_options[i].val != 0) {
-          out << '-' << static_cast<char>(m_options[i].val);
+        if (m_optionInfo[i].shortOption != 0) {
+          out << '-' << m_optionInfo[i].shortOption;
           out << ", ";
           length += 4;
         }
 
-        out << "--" << m_options[i].name;
+        out << "--" << m_optionInfo[i].longOption;
         length += m_optionInfo[i].longOption.size() + 2;
         length += argumentInfo(i, out);
 
@@ -421,7 +664,7 @@ class Args {
                          const std::vector<std::string>& enumValues = std::vector<std::string>()) {
 
     if (shortOption != 0) {
-      m_short2option[shortOption] = m_options.size();
+      m_shortOptions[static_cast<unsigned char>(shortOption)] = m_optionInfo.size() + 1;
     }
 
     std::string v;
@@ -432,12 +675,536 @@ class Args {
       std::for_each(v.begin(), v.end(), ValueConvert());
     }
 
-    struct OptionInfo const i = {enumValues, longOption, v, description, required};
+    struct OptionInfo const i = {enumValues,
+                                 longOption,
+                                 intern(longOption),
+                                 v,
+                                 description,
+                                 argument,
+                                 shortOption,
+                                 required,
+                                 false,
+                                 0};
     m_optionInfo.push_back(i);
+  }
+
+  void buildLongOptions() {
+    m_longOptions.resize(m_optionInfo.size());
+    for (size_t i = 0; i < m_optionInfo.size(); i++) {
+      m_longOptions[i] = i;
+    }
+    std::sort(m_longOptions.begin(), m_longOptions.end(), [this](size_t a, size_t b) {
+      return m_optionInfo[a].longOption < m_optionInfo[b].longOption;
+    });
+  }
+
+  /**
+   * Resets the results of the previous parse() call
+   */
+  void startParse() {
+    m_arguments.clear();
+    m_additionalArguments.clear();
+    m_parsedArguments.clear();
+    m_parsedAdditionalArguments.clear();
+    m_listArguments.clear();
+    m_files.clear();
+    m_ownedValues.clear();
+    m_selectedSubcommand.reset();
+
+    if (mAddHelp && !m_helpAdded) {
+      addOption("help", 'h', "Show this help message", No, false);
+      m_helpAdded = true;
+    }
 
-    struct option const o = {
-        m_optionInfo.back().longOption.c_str(), argument, nullptr, shortOption};
-    m_options.push_back(o);
+    if (m_longOptions.size() != m_optionInfo.size()) {
+      buildLongOptions();
+    }
+  }
+
+  /**
+   * Parses arguments that were already copied or read from files
+   */
+  auto parseArguments(const std::vector<std::string_view>& arguments,
+                      const char* prog,
+                      bool printHelp) -> Result {
+    std::vector<std::string_view> positional;
+    for (std::size_t i = 0; i < arguments.size(); i++) {
+      const std::string_view arg = arguments[i];
+      if (arg == "--") {
+        positional.insert(positional.end(), arguments.begin() + i + 1, arguments.end());
+        break;
+      }
+
+      if (arg.size() < 2 || arg[0] != '-') {
+        // Also includes "-" which usually refers to stdin
+        if (!m_subcommands.empty()) {
+          // The remaining arguments belong to the subcommand
+          positional.insert(positional.end(), arguments.begin() + i, arguments.end());
+          break;
+        }
+        positional.push_back(arg);
+        continue;
+      }
+
+      const bool valid = arg[1] == '-' ? parseLongOption(arguments, i, prog, printHelp)
+                                       : parseShortOptions(arguments, i, prog, printHelp);
+      if (!valid) {
+        if (printHelp) {
+          helpMessage(prog, std::cerr);
+        }
+        return Error;
+      }
+    }
+
+    if (mAddHelp && isSet("help")) {
+      if (printHelp) {
+        helpMessage(prog);
+      }
+      return Help;
+    }
+
+    for (const auto& info : m_optionInfo) {
+      if (info.required && !isSet(info.longOption)) {
+        if (printHelp) {
+          std::cerr << prog << ": option --" << info.longOption << " is required" << '\n';
+          helpMessage(prog, std::cerr);
+        }
+        return Error;
+      }
+    }
+
+    if (!m_subcommands.empty()) {
+      return parseSubcommand(positional, prog, printHelp);
+    }
+
+    // Parse additional options and check if all required options are set
+    size_t i = 0;
+    for (i = 0; i < positional.size(); i++) {
+      if (i >= m_additionalOptionInfo.size()) {
+        if (printHelp) {
+          std::cerr << prog << ": ignoring unknown parameter \"" << positional[i] << "\""
+                    << '\n';
+        }
+      } else {
+        m_additionalArguments[intern(m_additionalOptionInfo[i].name)] = positional[i];
+      }
+    }
+    if (i < m_additionalOptionInfo.size()) {
+      if (m_additionalOptionInfo[i].required) {
+        if (printHelp) {
+          std::cerr << prog << ": option <" << m_additionalOptionInfo[i].name << "> is required"
+                    << '\n';
+          helpMessage(prog, std::cerr);
+        }
+        return Error;
+      }
+    }
+
+    return Success;
+  }
+
+  /**
+   * Selects the subcommand (the first element of arguments) and parses the
+   * remaining arguments with its parser
+   */
+  auto parseSubcommand(const std::vector<std::string_view>& arguments,
+                       const char* prog,
+                       bool printHelp) -> Result {
+    if (arguments.empty()) {
+      if (printHelp) {
+        std::cerr << prog << ": a command is required" << '\n';
+        helpMessage(prog, std::cerr);
+      }
+      return Error;
+    }
+
+    const auto it =
+        std::find_if(m_subcommands.begin(), m_subcommands.end(), [&arguments](const auto& sub) {
+          return sub.name == arguments.front();
+        });
+    if (it == m_subcommands.end()) {
+      if (printHelp) {
+        std::cerr << prog << ": unknown command \"" << arguments.front() << "\"" << '\n';
+        helpMessage(prog, std::cerr);
+      }
+      return Error;
+    }
+
+    if (!it->args) {
+      it->args = std::make_unique<Args>(it->description, mAddHelp);
+      if (it->setup) {
+        it->setup(*it->args);
+      }
+      it->prog = std::string(prog) + ' ' + it->name;
+    }
+    m_selectedSubcommand = it - m_subcommands.begin();
+
+    // The arguments still point into the storage of this parser
+    it->args->startParse();
+    return it->args->parseArguments(
+        std::vector<std::string_view>(arguments.begin() + 1, arguments.end()),
+        it->prog.c_str(),
+        printHelp);
+  }
+
+  /**
+   * @return The index of the option in m_optionInfo or UnknownOption if the
+   *  option does not exist or the abbreviation is ambiguous
+   */
+  [[nodiscard]] auto findLongOption(std::string_view name, const char* prog, bool printHelp) const
+      -> size_t {
+    const auto it = std::lower_bound(
+        m_longOptions.begin(),
+        m_longOptions.end(),
+        name,
+        [this](size_t option, std::string_view n) { return m_optionInfo[option].longOption < n; });
+    if (name.empty() || it == m_longOptions.end() ||
+        !StringUtils::startsWith(m_optionInfo[*it].longOption, name)) {
+      if (printHelp) {
+        std::cerr << prog << ": unrecognized option '--" << name << "'" << '\n';
+      }
+      return UnknownOption;
+    }
+    if (m_optionInfo[*it].longOption.size() == name.size()) {
+      return *it;
+    }
+
+    // Abbreviations have to be unique
+    const auto next = it + 1;
+    if (next != m_longOptions.end() &&
+        StringUtils::startsWith(m_optionInfo[*next].longOption, name)) {
+      if (printHelp) {
+        std::cerr << prog << ": option '--" << name << "' is ambiguous" << '\n';
+      }
+      return UnknownOption;
+    }
+    return *it;
+  }
+
+  /**
+   * Parses the long option arguments[i]
+   *
+   * @param i Is incremented if the value is stored in the next argument
+   */
+  auto parseLongOption(const std::vector<std::string_view>& arguments,
+                       size_t& i,
+                       const char* prog,
+                       bool printHelp) -> bool {
+    std::string_view name = arguments[i].substr(2);
+    std::optional<std::string_view> value;
+    const size_t equal = name.find('=');
+    if (equal != std::string_view::npos) {
+      value = name.substr(equal + 1);
+      name = name.substr(0, equal);
+    }
+
+    const size_t index = findLongOption(name, prog, printHelp);
+    if (index == UnknownOption) {
+      return false;
+    }
+
+    if (!value.has_value() && m_optionInfo[index].argument == Required &&
+        i + 1 < arguments.size()) {
+      value = arguments[++i];
+    }
+    return setLongOption(index, value, prog, printHelp);
+  }
+
+  /**
+   * Checks and stores the value of a long option
+   */
+  auto setLongOption(size_t index,
+                     std::optional<std::string_view> value,
+                     const char* prog,
+                     bool printHelp) -> bool {
+    const OptionInfo& info = m_optionInfo[index];
+    if (info.argument == No && value.has_value()) {
+      if (printHelp) {
+        std::cerr << prog << ": option '--" << info.longOption << "' doesn't allow an argument"
+                  << '\n';
+      }
+      return false;
+    }
+    if (info.argument == Required && !value.has_value()) {
+      if (printHelp) {
+        std::cerr << prog << ": option '--" << info.longOption << "' requires an argument"
+                  << '\n';
+      }
+      return false;
+    }
+
+    return setOption(index, value, prog, printHelp);
+  }
+
+  /**
+   * Parses one or more clustered short options in arguments[i] (e.g. "-vx" or "-ofile")
+   *
+   * @param i Is incremented if the value is stored in the next argument
+   */
+  auto parseShortOptions(const std::vector<std::string_view>& arguments,
+                         size_t& i,
+                         const char* prog,
+                         bool printHelp) -> bool {
+    const std::string_view arg = arguments[i];
+    for (size_t j = 1; j < arg.size(); j++) {
+      const size_t index = m_shortOptions[static_cast<unsigned char>(arg[j])];
+      if (index == 0) {
+        if (printHelp) {
+          std::cerr << prog << ": invalid option -- '" << arg[j] << "'" << '\n';
+        }
+        return false;
+      }
+
+      const OptionInfo& info = m_optionInfo[index - 1];
+      if (info.argument == No) {
+        if (!setOption(index - 1, {}, prog, printHelp)) {
+          return false;
+        }
+        continue;
+      }
+
+      // The rest of the argument is the value
+      std::optional<std::string_view> value;
+      if (j + 1 < arg.size()) {
+        value = arg.substr(j + 1);
+      } else if (info.argument == Required) {
+        if (i + 1 >= arguments.size()) {
+          if (printHelp) {
+            std::cerr << prog << ": option requires an argument -- '" << arg[j] << "'" << '\n';
+          }
+          return false;
+        }
+        value = arguments[++i];
+      }
+      return setOption(index - 1, value, prog, printHelp);
+    }
+
+    return true;
+  }
+
+  /**
+   * Stores the value of an option
+   *
+   * @param value The value (nullopt if the option has no value)
+   * @return False if the value is not valid
+   */
+  auto setOption(size_t index,
+                 std::optional<std::string_view> value,
+                 const char* prog,
+                 bool printHelp) -> bool {
+    const OptionInfo& info = m_optionInfo[index];
+
+    std::string_view& argument = m_arguments[info.name];
+    argument = value.value_or(std::string_view());
+
+    if (!info.enumValues.empty()) {
+      const auto i = std::find(info.enumValues.begin(), info.enumValues.end(), argument);
+      if (i == info.enumValues.end()) {
+        if (printHelp) {
+          std::cerr << prog << ": option --" << info.longOption << " must be set to "
+                    << info.value << '\n';
+        }
+        return false;
+      }
+
+      argument = m_ownedValues.emplace_back(StringUtils::toString(i - info.enumValues.begin()));
+    }
+
+    if (info.list && !argument.empty()) {
+      std::vector<std::string_view>& values = m_listArguments[info.name];
+      std::string_view remaining = argument;
+      while (info.delimiter != 0) {
+        const size_t end = remaining.find(info.delimiter);
+        if (end == std::string_view::npos) {
+          break;
+        }
+        values.push_back(remaining.substr(0, end));
+        remaining.remove_prefix(end + 1);
+      }
+      values.push_back(remaining);
+    }
+
+    if (index == m_configOption) {
+      return readConfigFile(argument, prog, printHelp);
+    }
+
+    return true;
+  }
+
+  /**
+   * Maps a response or config file and keeps it until the next call to parse()
+   *
+   * @return The content of the file or nullopt if the file cannot be read
+   */
+  auto openFile(std::string_view filename, const char* prog, bool printHelp)
+      -> std::optional<std::string_view> {
+    if (m_fileDepth >= MaxFileDepth) {
+      if (printHelp) {
+        std::cerr << prog << ": files nested too deeply (" << filename << ")" << '\n';
+      }
+      return {};
+    }
+
+    auto file = std::make_unique<MappedFile>(std::string(filename));
+    if (!file->valid()) {
+      if (printHelp) {
+        std::cerr << prog << ": could not read " << filename << '\n';
+      }
+      return {};
+    }
+
+    m_files.push_back(std::move(file));
+    return m_files.back()->view();
+  }
+
+  /**
+   * Splits a response file into arguments and appends them to arguments
+   */
+  auto readResponseFile(std::string_view filename,
+                        std::vector<std::string_view>& arguments,
+                        const char* prog,
+                        bool printHelp) -> bool {
+    const auto content = openFile(filename, prog, printHelp);
+    if (!content.has_value()) {
+      return false;
+    }
+
+    m_fileDepth++;
+    const std::string_view str = content.value();
+    size_t i = 0;
+    while (i < str.size()) {
+      if (StringUtils::isSpaceAscii(str[i])) {
+        i++;
+        continue;
+      }
+      if (str[i] == '#') {
+        i = std::min(str.find('\n', i), str.size());
+        continue;
+      }
+
+      // Arguments without quotes and escapes refer directly to the file
+      const size_t start = i;
+      while (i < str.size() && !StringUtils::isSpaceAscii(str[i]) && str[i] != '\'' &&
+             str[i] != '"' && str[i] != '\\') {
+        i++;
+      }
+      std::string_view arg = str.substr(start, i - start);
+      if (i < str.size() && !StringUtils::isSpaceAscii(str[i])) {
+        i = start;
+        arg = m_ownedValues.emplace_back(unquote(str, i));
+      }
+
+      if (arg.size() > 1 && arg[0] == '@') {
+        if (!readResponseFile(arg.substr(1), arguments, prog, printHelp)) {
+          m_fileDepth--;
+          return false;
+        }
+      } else {
+        arguments.push_back(arg);
+      }
+    }
+    m_fileDepth--;
+
+    return true;
+  }
+
+  /**
+   * Reads one argument with quotes and escapes
+   *
+   * @param i The start of the argument, set to the end of the argument
+   */
+  static auto unquote(std::string_view str, size_t& i) -> std::string {
+    std::string arg;
+    char quote = 0;
+    for (; i < str.size(); i++) {
+      const char c = str[i];
+      if (quote != 0) {
+        if (c == quote) {
+          quote = 0;
+        } else if (c == '\\' && quote == '"' && i + 1 < str.size()) {
+          arg.push_back(str[++i]);
+        } else {
+          arg.push_back(c);
+        }
+      } else if (StringUtils::isSpaceAscii(c)) {
+        break;
+      } else if (c == '\'' || c == '"') {
+        quote = c;
+      } else if (c == '\\' && i + 1 < str.size()) {
+        arg.push_back(str[++i]);
+      } else {
+        arg.push_back(c);
+      }
+    }
+    return arg;
+  }
+
+  /**
+   * Sets all options from a config file
+   */
+  auto readConfigFile(std::string_view filename, const char* prog, bool printHelp) -> bool {
+    const auto content = openFile(filename, prog, printHelp);
+    if (!content.has_value()) {
+      return false;
+    }
+
+    m_fileDepth++;
+    std::string_view str = content.value();
+    bool valid = true;
+    while (valid && !str.empty()) {
+      const size_t end = std::min(str.find('\n'), str.size());
+      const std::string_view line = StringUtils::trimView(str.substr(0, end));
+      str.remove_prefix(std::min(end + 1, str.size()));
+      if (line.empty() || line.front() == '#') {
+        continue;
+      }
+
+      std::string_view name = line;
+      std::optional<std::string_view> value;
+      const size_t equal = line.find('=');
+      if (equal != std::string_view::npos) {
+        name = StringUtils::rtrimView(line.substr(0, equal));
+        value = StringUtils::ltrimView(line.substr(equal + 1));
+      }
+
+      const size_t index = findLongOption(name, prog, printHelp);
+      valid = index != UnknownOption && setLongOption(index, value, prog, printHelp);
+    }
+    m_fileDepth--;
+
+    return valid;
+  }
+
+  /** Character types are parsed as characters, not as numbers */
+  template <typename T>
+  static constexpr bool IsCharacter =
+      std::is_same_v<std::remove_cv_t<T>, char> ||
+      std::is_same_v<std::remove_cv_t<T>, signed char> ||
+      std::is_same_v<std::remove_cv_t<T>, unsigned char> ||
+      std::is_same_v<std::remove_cv_t<T>, wchar_t> ||
+      std::is_same_v<std::remove_cv_t<T>, char16_t> ||
+      std::is_same_v<std::remove_cv_t<T>, char32_t>;
+
+  /**
+   * Converts a value, numbers are parsed without allocating memory
+   */
+  template <typename T>
+  auto parseValue(std::string_view value) -> T {
+    if constexpr (std::is_same_v<T, std::string_view>) {
+      return value;
+    } else if constexpr (std::is_same_v<T, const char*>) {
+      // The values are not null terminated; keep a copy until the next parse()
+      return m_ownedValues.emplace_back(value).c_str();
+    } else {
+      if constexpr (std::is_arithmetic_v<T> && !std::is_same_v<T, bool> && !IsCharacter<T>) {
+        T result{};
+        if (StringUtils::parseNumber(value, result)) {
+          return result;
+        }
+      }
+      // Invalid numbers are converted like before (e.g. "12abc" -> 12)
+      return StringUtils::parse<T>(std::string(value));
+    }
   }
 
   /**
@@ -447,13 +1214,15 @@ class Args {
    * @return The number if characters written
    */
   auto argumentInfo(size_t i, std::ostream& out) -> size_t {
-    switch (m_options[i].has_arg) {
-    case required_argument:
+    switch (m_optionInfo[i].argument) {
+    case Required:
       out << ' ' << m_optionInfo[i].value;
       return m_optionInfo[i].value.size() + 1;
-    case optional_argument:
+    case Optional:
       out << " [" << m_optionInfo[i].value << ']';
       return m_optionInfo[i].value.size() + 3;
+    case No:
+      break;
     }
 
     return 0;
@@ -466,7 +1235,7 @@ class Args {
 };
 
 template <>
-inline auto utils::Args::getArgument(const std::string& option, bool defaultArgument) -> bool {
+inline auto utils::Args::getArgument(InternedString option, bool defaultArgument) -> bool {
   if (!isSet(option)) {
     return defaultArgument;
   }
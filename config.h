@@ -0,0 +1,373 @@
+// SPDX-FileCopyrightText: 2024 Technical University of Munich
+//
+// SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef UTILS_CONFIG_H_
+#define UTILS_CONFIG_H_
+
+#include "utils/args.h"
+#include "utils/env.h"
+#include "utils/logger.h"
+#include "utils/stringutils.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace utils {
+
+/**
+ * An immutable set of typed settings, resolved from several sources
+ *
+ * Create it with a ConfigBuilder. All lookups are allocation-free and can be
+ * done from any thread.
+ */
+class Config {
+  public:
+  /** Where a value comes from (ordered by increasing precedence) */
+  enum class Source { Default, File, Env, Args };
+
+  using Value = std::variant<bool, std::int64_t, double, std::string>;
+
+  struct Entry {
+    std::string key;
+    Value value;
+    Source source;
+    /** Name of the file, environment variable or option that set the value */
+    std::string origin;
+    /** Printed by dump() */
+    std::string description;
+  };
+
+  private:
+  /** Sorted by key */
+  std::vector<Entry> m_entries;
+
+  explicit Config(std::vector<Entry> entries) : m_entries(std::move(entries)) {}
+
+  friend class ConfigBuilder;
+
+  public:
+  Config() = default;
+
+  [[nodiscard]] auto contains(std::string_view key) const -> bool { return find(key) != nullptr; }
+
+  /**
+   * @return The setting converted to T (arithmetic types can be converted into each other)
+   */
+  template <typename T>
+  [[nodiscard]] auto get(std::string_view key) const -> T {
+    const Value& value = entry(key).value;
+    if constexpr (std::is_same_v<T, std::string>) {
+      return std::get<std::string>(value);
+    } else {
+      static_assert(std::is_arithmetic_v<T>, "Only arithmetic types and strings are supported");
+      return std::visit(
+          [](const auto& v) -> T {
+            if constexpr (std::is_arithmetic_v<std::decay_t<decltype(v)>>) {
+              return static_cast<T>(v);
+            } else {
+              throw std::bad_variant_access();
+            }
+          },
+          value);
+    }
+  }
+
+  /**
+   * @return A reference to a string setting
+   */
+  [[nodiscard]] auto getString(std::string_view key) const -> const std::string& {
+    return std::get<std::string>(entry(key).value);
+  }
+
+  [[nodiscard]] auto source(std::string_view key) const -> Source { return entry(key).source; }
+
+  [[nodiscard]] auto entries() const -> const std::vector<Entry>& { return m_entries; }
+
+  /**
+   * Writes all settings with their source and description
+   *
+   * Each line has the form
+   * <code>key = value # source [origin][: description]</code>
+   */
+  void dump(std::ostream& out) const {
+    for (const auto& e : m_entries) {
+      out << e.key << " = ";
+      std::visit(
+          [&out](const auto& v) {
+            if constexpr (std::is_same_v<std::decay_t<decltype(v)>, bool>) {
+              out << (v ? "true" : "false");
+            } else {
+              out << v;
+            }
+          },
+          e.value);
+      out << " # " << sourceName(e.source);
+      if (!e.origin.empty()) {
+        out << ' ' << e.origin;
+      }
+      if (!e.description.empty()) {
+        out << ": " << e.description;
+      }
+      out << '\n';
+    }
+  }
+
+  static auto sourceName(Source source) -> const char* {
+    switch (source) {
+    case Source::Default:
+      return "default";
+    case Source::File:
+      return "file";
+    case Source::Env:
+      return "env";
+    case Source::Args:
+      return "args";
+    }
+    return "unknown";
+  }
+
+  private:
+  [[nodiscard]] auto find(std::string_view key) const -> const Entry* {
+    const auto it = std::lower_bound(
+        m_entries.begin(), m_entries.end(), key, [](const Entry& e, std::string_view k) {
+          return e.key < k;
+        });
+    if (it == m_entries.end() || it->key != key) {
+      return nullptr;
+    }
+    return &*it;
+  }
+
+  [[nodiscard]] auto entry(std::string_view key) const -> const Entry& {
+    const Entry* e = find(key);
+    if (e == nullptr) {
+      logError() << "Unknown configuration key" << std::string(key);
+    }
+    return *e;
+  }
+};
+
+/**
+ * Collects declarations and sources for a Config
+ *
+ * The precedence is Args > Env > config files (later files override earlier
+ * ones) > default values. A key is looked up as the long option
+ * <code>--key</code>, as the environment variable <code>PREFIX_KEY</code>
+ * (upper case, '-' and '.' replaced by '_') and as <code>key = value</code>
+ * in config files.
+ */
+class ConfigBuilder {
+  private:
+  std::vector<Config::Entry> m_entries;
+
+  std::optional<std::string> m_envPrefix;
+
+  Args* m_args{nullptr};
+
+  /** Content of the config files (key, value, file name) */
+  std::vector<std::tuple<std::string, std::string, std::string>> m_fileValues;
+
+  public:
+  /**
+   * Declares a setting
+   *
+   * Each key can only be declared once.
+   */
+  template <typename T>
+  auto declare(const std::string& key, T defaultValue, const std::string& description = "")
+      -> ConfigBuilder& {
+    if (find(m_entries, key) != nullptr) {
+      logError() << "Configuration key" << key << "is declared twice";
+      return *this;
+    }
+    m_entries.push_back(
+        {key, toValue(std::move(defaultValue)), Config::Source::Default, "", description});
+    return *this;
+  }
+
+  /**
+   * Reads environment variables with the given prefix
+   */
+  auto addEnv(const std::string& prefix) -> ConfigBuilder& {
+    m_envPrefix = prefix;
+    return *this;
+  }
+
+  /**
+   * Reads options from parsed command line arguments
+   */
+  auto addArgs(Args& args) -> ConfigBuilder& {
+    m_args = &args;
+    return *this;
+  }
+
+  /**
+   * Reads a file with one <code>key = value</code> per line
+   *
+   * Empty lines and lines starting with '#' are ignored.
+   *
+   * @return False if the file could not be read
+   */
+  auto addFile(const std::string& filename) -> bool {
+    std::ifstream file(filename);
+    if (!file) {
+      logWarning() << "Could not open configuration file" << filename;
+      return false;
+    }
+
+    std::string line;
+    unsigned long lineNumber = 0;
+    while (std::getline(file, line)) {
+      lineNumber++;
+      const std::string_view trimmed = StringUtils::trimView(line);
+      if (trimmed.empty() || trimmed.front() == '#') {
+        continue;
+      }
+
+      const std::size_t equal = trimmed.find('=');
+      if (equal == std::string_view::npos) {
+        logWarning() << "Ignoring line" << lineNumber << "in" << filename << "(missing '=')";
+        continue;
+      }
+      m_fileValues.emplace_back(std::string(StringUtils::trimView(trimmed.substr(0, equal))),
+                                std::string(StringUtils::trimView(trimmed.substr(equal + 1))),
+                                filename);
+    }
+    return true;
+  }
+
+  /**
+   * Resolves all declared settings
+   */
+  [[nodiscard]] auto resolve() const -> Config {
+    std::vector<Config::Entry> entries = m_entries;
+
+    for (const auto& [key, value, filename] : m_fileValues) {
+      Config::Entry* e = find(entries, key);
+      if (e == nullptr) {
+        logWarning() << "Ignoring unknown key" << key << "in" << filename;
+        continue;
+      }
+      set(*e, value, Config::Source::File, filename);
+    }
+
+    if (m_envPrefix.has_value()) {
+      const Env env(m_envPrefix.value());
+      for (auto& e : entries) {
+        std::string name = e.key;
+        std::replace(name.begin(), name.end(), '-', '_');
+        std::replace(name.begin(), name.end(), '.', '_');
+        StringUtils::toUpperAscii(name);
+
+        const auto value = env.getOptional<std::string>(name);
+        if (value.has_value()) {
+          set(e, value.value(), Config::Source::Env, m_envPrefix.value() + name);
+        }
+      }
+    }
+
+    if (m_args != nullptr) {
+      for (auto& e : entries) {
+        if (m_args->isSet(e.key)) {
+          std::string value = m_args->getArgument<std::string>(e.key);
+          if (value.empty() && std::holds_alternative<bool>(e.value)) {
+            // Flag without argument
+            value = "true";
+          }
+          set(e, value, Config::Source::Args, "--" + e.key);
+        }
+      }
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const auto& a, const auto& b) {
+      return a.key < b.key;
+    });
+    return Config(std::move(entries));
+  }
+
+  private:
+  template <typename T>
+  static auto toValue(T value) -> Config::Value {
+    if constexpr (std::is_same_v<T, bool>) {
+      return value;
+    } else if constexpr (std::is_integral_v<T>) {
+      return static_cast<std::int64_t>(value);
+    } else if constexpr (std::is_floating_point_v<T>) {
+      return static_cast<double>(value);
+    } else {
+      return std::string(value);
+    }
+  }
+
+  static auto find(std::vector<Config::Entry>& entries, std::string_view key) -> Config::Entry* {
+    for (auto& e : entries) {
+      if (e.key == key) {
+        return &e;
+      }
+    }
+    return nullptr;
+  }
+
+  /**
+   * Parses value with the type of the declaration
+   *
+   * Invalid values are reported and ignored, i.e. the setting keeps the value
+   * from the source with the next lower precedence.
+   */
+  static void set(Config::Entry& e,
+                  const std::string& value,
+                  Config::Source source,
+                  const std::string& origin) {
+    const bool valid = std::visit([&value](auto& v) { return parseValue(value, v); }, e.value);
+    if (!valid) {
+      logWarning() << "Ignoring invalid value" << value << "for" << e.key << "from"
+                   << Config::sourceName(source) << origin;
+      return;
+    }
+    e.source = source;
+    e.origin = origin;
+  }
+
+  /**
+   * @return False if str is not a valid value (result is not modified)
+   */
+  static auto parseValue(const std::string& str, bool& result) -> bool {
+    const std::string_view s = StringUtils::trimView(str);
+    if (StringUtils::equalsIgnoreCase(s, "on") || StringUtils::equalsIgnoreCase(s, "yes") ||
+        StringUtils::equalsIgnoreCase(s, "true") || s == "1") {
+      result = true;
+      return true;
+    }
+    if (StringUtils::equalsIgnoreCase(s, "off") || StringUtils::equalsIgnoreCase(s, "no") ||
+        StringUtils::equalsIgnoreCase(s, "false") || s == "0") {
+      result = false;
+      return true;
+    }
+    return false;
+  }
+
+  template <typename T>
+  static auto parseValue(const std::string& str, T& result) -> bool {
+    return StringUtils::parseNumber(str, result);
+  }
+
+  static auto parseValue(const std::string& str, std::string& result) -> bool {
+    result = str;
+    return true;
+  }
+};
+
+} // namespace utils
+
+#endif // UTILS_CONFIG_H_
@@ -8,68 +8,293 @@
 #ifndef UTILS_ENV_H_
 #define UTILS_ENV_H_
 
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
 #include <cstdlib>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <string>
+#include <string_view>
+#include <tuple>
 #include <type_traits>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
+#include "utils/stringpool.h"
 #include "utils/stringutils.h"
+#include "utils/typedcache.h"
+
+// Not declared by all versions of unistd.h
+extern "C" char** environ; // NOLINT
 
 namespace utils {
 
+/**
+ * Process-wide, immutable copy of the environment
+ *
+ * The snapshot is taken on first use and stored as a flat table sorted by
+ * name, so variables with a common prefix are adjacent. Reading is lock-free
+ * and safe from any thread, unlike std::getenv() which races with setenv().
+ * Changes to the environment are only visible after refresh().
+ */
+class EnvSnapshot {
+  public:
+  struct Variable {
+    std::string_view name;
+    /** Null terminated */
+    std::string_view value;
+  };
+
+  /**
+   * One version of the environment
+   */
+  class Table {
+    private:
+    std::string m_storage;
+    std::vector<Variable> m_variables;
+
+    friend class EnvSnapshot;
+
+    public:
+    /**
+     * @return All variables, sorted by name
+     */
+    [[nodiscard]] auto variables() const -> const std::vector<Variable>& { return m_variables; }
+
+    /**
+     * @return Iterators to all variables starting with prefix
+     */
+    [[nodiscard]] auto range(std::string_view prefix) const
+        -> std::pair<const Variable*, const Variable*> {
+      const Variable* first = m_variables.data();
+      const Variable* last = first + m_variables.size();
+      first = std::lower_bound(first, last, prefix, [](const Variable& var, std::string_view p) {
+        return var.name < p;
+      });
+      last = std::upper_bound(first, last, prefix, [](std::string_view p, const Variable& var) {
+        return p < var.name.substr(0, p.size());
+      });
+      return {first, last};
+    }
+
+    /**
+     * @return The value of the variable or nullptr if it is not set
+     */
+    [[nodiscard]] auto get(std::string_view name) const -> const char* {
+      return find(m_variables.data(), m_variables.data() + m_variables.size(), 0, name);
+    }
+
+    /**
+     * Finds a variable in a range returned by range()
+     *
+     * @param skip Number of characters of the names that are skipped (the length of the prefix)
+     * @return The value of the variable or nullptr if it is not set
+     */
+    static auto
+        find(const Variable* first, const Variable* last, std::size_t skip, std::string_view name)
+            -> const char* {
+      const auto* var = std::lower_bound(first, last, name, [skip](const Variable& v, auto n) {
+        return v.name.substr(skip) < n;
+      });
+      if (var == last || var->name.substr(skip) != name) {
+        return nullptr;
+      }
+      return var->value.data();
+    }
+  };
+
+  /**
+   * @return The current snapshot; it stays valid until the end of the program
+   */
+  static auto get() -> const Table& { return *state().current.load(std::memory_order_acquire); }
+
+  /**
+   * Takes a new snapshot of the environment
+   *
+   * Old snapshots are kept alive, so values obtained before remain valid.
+   */
+  static void refresh() {
+    State& s = state();
+    const std::lock_guard lock(s.mutex);
+    s.tables.push_back(capture());
+    s.current.store(s.tables.back().get(), std::memory_order_release);
+  }
+
+  private:
+  struct State {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<const Table>> tables;
+    std::atomic<const Table*> current;
+
+    State() {
+      tables.push_back(capture());
+      current.store(tables.back().get(), std::memory_order_release);
+    }
+  };
+
+  static auto state() -> State& {
+    static State s;
+    return s;
+  }
+
+  static auto capture() -> std::unique_ptr<const Table> {
+    auto table = std::make_unique<Table>();
+
+    // Copy everything first, views into the storage must not be invalidated later
+    std::vector<std::size_t> offsets;
+    for (char** env = environ; env != nullptr && *env != nullptr; ++env) {
+      offsets.push_back(table->m_storage.size());
+      table->m_storage.append(*env);
+      table->m_storage.push_back('\0');
+    }
+
+    const std::string_view storage = table->m_storage;
+    for (const std::size_t offset : offsets) {
+      const std::string_view entry = storage.data() + offset;
+      const std::size_t equal = entry.find('=');
+      if (equal == std::string_view::npos) {
+        continue;
+      }
+      table->m_variables.push_back({entry.substr(0, equal), entry.substr(equal + 1)});
+    }
+
+    // Like getenv(), use the first definition if a variable is defined multiple times
+    std::stable_sort(table->m_variables.begin(),
+                     table->m_variables.end(),
+                     [](const Variable& a, const Variable& b) { return a.name < b.name; });
+    table->m_variables.erase(std::unique(table->m_variables.begin(),
+                                         table->m_variables.end(),
+                                         [](const Variable& a, const Variable& b) {
+                                           return a.name == b.name;
+                                         }),
+                             table->m_variables.end());
+
+    return table;
+  }
+};
+
 /**
  * Function(s) to handle environment variables
+ *
+ * An Env is a cheap view on the variables of the EnvSnapshot that start with
+ * the prefix. Lookups by name do not modify the Env and can be done from any
+ * thread.
  */
 class Env {
   private:
   std::string prefix;
-  std::unordered_map<std::string, std::optional<std::string>> cache;
+
+  /** The snapshot the range refers to */
+  const EnvSnapshot::Table* table{nullptr};
+  const EnvSnapshot::Variable* first{nullptr};
+  const EnvSnapshot::Variable* last{nullptr};
+
+  /** Parsed values for interned names in the current snapshot */
+  TypedCache cache;
 
   public:
-  Env(const std::string& prefix) : prefix(prefix) {}
+  Env(const std::string& envPrefix) : prefix(envPrefix) { update(); }
+
+  /**
+   * Takes a new snapshot of the environment for all Env objects
+   *
+   * Call this after modifying the environment with setenv() or putenv().
+   */
+  static void refresh() { EnvSnapshot::refresh(); }
 
   template <typename T>
-  auto getOptional(const std::string& name) -> std::optional<T> {
-    if (cache.find(name) == cache.end()) {
-      char* value = std::getenv((prefix + name).c_str());
-      if (value == nullptr) {
-        cache[name] = std::optional<std::string>();
-      } else {
-        cache[name] = std::make_optional<std::string>(value);
-      }
+  auto getOptional(std::string_view name) const -> std::optional<T> {
+    const EnvSnapshot::Table& current = EnvSnapshot::get();
+    if (&current == table) {
+      return convert<T>(EnvSnapshot::Table::find(first, last, prefix.size(), name));
     }
 
-    const auto value = cache.at(name);
-    if (cache.at(name).has_value()) {
-      return std::make_optional<T>(StringUtils::parse<T>(value.value()));
-    } else {
-      return std::optional<T>();
+    // The environment was refreshed, search in the new snapshot
+    const auto [newFirst, newLast] = current.range(prefix);
+    return convert<T>(EnvSnapshot::Table::find(newFirst, newLast, prefix.size(), name));
+  }
+
+  /**
+   * Same as getOptional(std::string_view) but the value is parsed only once
+   *
+   * Parsed values are cached per Env object (keyed by name and type), so
+   * this function is not thread-safe.
+   */
+  template <typename T>
+  auto getOptional(InternedString name) -> std::optional<T> {
+    if (&EnvSnapshot::get() != table) {
+      update();
     }
+
+    return cache.get<std::optional<T>>(name, [this, name]() {
+      return convert<T>(EnvSnapshot::Table::find(first, last, prefix.size(), name.view()));
+    });
+  }
+
+  /**
+   * Resolves an environment variable once
+   *
+   * The binding is not updated by refresh().
+   */
+  template <typename T>
+  auto bind(std::string_view name, T defaultVal) const -> Binding<T> {
+    return Binding<T>(get(name, std::move(defaultVal)));
   }
 
   template <typename T>
-  auto get(const std::string& name, T&& defaultVal)
+  auto get(std::string_view name, T&& defaultVal) const
       -> std::enable_if_t<!std::is_array_v<T>, std::decay_t<T>> {
     // mirror requirements for an optional
-    const auto value = getOptional<std::decay_t<T>>(name);
+    return valueOr(getOptional<std::decay_t<T>>(name), std::forward<T>(defaultVal));
+  }
 
-    if (value.has_value()) {
-      return value.value();
-    } else {
-      return std::forward<T>(defaultVal);
-    }
+  template <typename T>
+  auto get(InternedString name, T&& defaultVal)
+      -> std::enable_if_t<!std::is_array_v<T>, std::decay_t<T>> {
+    return valueOr(getOptional<std::decay_t<T>>(name), std::forward<T>(defaultVal));
   }
 
   template <typename T>
-  auto get(const std::string& name, const T* defaultVal)
+  auto get(std::string_view name, const T* defaultVal) const
       -> std::enable_if_t<std::is_convertible_v<T*, std::string>, std::string> {
-    const auto value = getOptional<std::string>(name);
+    return valueOr(getOptional<std::string>(name), std::string(defaultVal));
+  }
+
+  template <typename T>
+  auto get(InternedString name, const T* defaultVal)
+      -> std::enable_if_t<std::is_convertible_v<T*, std::string>, std::string> {
+    return valueOr(getOptional<std::string>(name), std::string(defaultVal));
+  }
+
+  private:
+  void update() {
+    table = &EnvSnapshot::get();
+    std::tie(first, last) = table->range(prefix);
+    cache.clear();
+  }
+
+  template <typename T>
+  static auto convert(const char* value) -> std::optional<T> {
+    if (value == nullptr) {
+      return std::optional<T>();
+    }
+    if constexpr (std::is_same_v<T, const char*>) {
+      // Points to the snapshot which is never freed
+      return std::make_optional<T>(value);
+    } else {
+      return std::make_optional<T>(StringUtils::parse<T>(value));
+    }
+  }
 
+  template <typename T, typename U>
+  static auto valueOr(std::optional<T>&& value, U&& defaultVal) -> T {
     if (value.has_value()) {
-      return value.value();
+      return std::move(value.value());
     } else {
-      return std::string(defaultVal);
+      return std::forward<U>(defaultVal);
     }
   }
 };
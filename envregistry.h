@@ -0,0 +1,466 @@
+// SPDX-FileCopyrightText: 2024 Technical University of Munich
+//
+// SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef UTILS_ENVREGISTRY_H_
+#define UTILS_ENVREGISTRY_H_
+
+#include "utils/env.h"
+#include "utils/logger.h"
+#include "utils/stringutils.h"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace utils {
+
+/**
+ * Type of a registered environment variable
+ */
+enum class EnvType { Bool, Int, UInt, Double, String };
+
+/**
+ * Declaration of an environment variable
+ */
+struct EnvVariable {
+  /** Name without the prefix of the registry */
+  std::string_view name;
+  EnvType type;
+  /** Default value as it would be written in the environment */
+  std::string_view defaultValue;
+  std::string_view description;
+};
+
+/**
+ * A compile-time catalog of environment variables
+ *
+ * The names are mapped to their declaration with a perfect hash function that
+ * is computed at compile time (hash and displace). The values of all
+ * variables are read and parsed once per EnvSnapshot, so get() only has to
+ * hash the name.
+ *
+ * Example:
+ * <code>
+ * constexpr EnvRegistry SeisSolEnv("SEISSOL_",
+ *     {{"CHECKPOINT_INTERVAL", EnvType::Double, "0", "Time between checkpoints"},
+ *      {"OUTPUT_RANKS", EnvType::Int, "-1", "Ranks that write output"}});
+ * static_assert(SeisSolEnv.contains("OUTPUT_RANKS"));
+ * const double interval = SeisSolEnv.get<double>("CHECKPOINT_INTERVAL");
+ * </code>
+ */
+template <std::size_t N>
+class EnvRegistry {
+  private:
+  static constexpr auto tableSize() -> std::size_t {
+    std::size_t size = 1;
+    while (size < N) {
+      size *= 2;
+    }
+    return size;
+  }
+
+  /** Number of slots and buckets (a power of two) */
+  static constexpr std::size_t Size = tableSize();
+
+  /** Marks empty slots */
+  static constexpr std::size_t Empty = N;
+
+  std::string_view m_prefix;
+
+  std::array<EnvVariable, N> m_variables{};
+
+  /** Seed of the first-level hash which distributes the names to buckets */
+  std::uint64_t m_seed{0};
+
+  /**
+   * Displacement for each bucket: > 0 for the seed of the second-level hash,
+   * < 0 for -(slot + 1) if the bucket contains a single name
+   */
+  std::array<std::int64_t, Size> m_displacement{};
+
+  /** Index of the variable stored in each slot */
+  std::array<std::size_t, Size> m_slots{};
+
+  /**
+   * Effective value of a variable
+   *
+   * Only the member matching the type of the variable is set.
+   */
+  struct Value {
+    /** Value from the environment (points into the snapshot) or nullptr */
+    const char* raw{nullptr};
+    bool boolValue{false};
+    long long intValue{0};
+    unsigned long long uintValue{0};
+    double doubleValue{0};
+    std::string_view stringValue;
+  };
+
+  /**
+   * All values for one snapshot
+   */
+  struct Resolved {
+    const EnvSnapshot::Table* table;
+    std::array<Value, N> values;
+    /** Values of an older snapshot (kept alive like the snapshot itself) */
+    const Resolved* previous;
+  };
+
+  /** Values for the most recent snapshot that was used (or nullptr) */
+  mutable std::atomic<const Resolved*> m_resolved{nullptr};
+
+  public:
+  constexpr EnvRegistry(std::string_view prefix, const EnvVariable (&variables)[N])
+      : m_prefix(prefix) {
+    for (std::size_t i = 0; i < N; i++) {
+      m_variables[i] = variables[i];
+      for (std::size_t j = 0; j < i; j++) {
+        if (variables[i].name == variables[j].name) {
+          throw std::invalid_argument("Environment variable registered twice");
+        }
+      }
+    }
+
+    while (!build()) {
+      m_seed++;
+    }
+  }
+
+  [[nodiscard]] constexpr auto prefix() const -> std::string_view { return m_prefix; }
+
+  [[nodiscard]] static constexpr auto size() -> std::size_t { return N; }
+
+  /**
+   * @return The index of the variable or size() if it is not registered
+   */
+  [[nodiscard]] constexpr auto index(std::string_view name) const -> std::size_t {
+    const std::int64_t displacement = m_displacement[hash(name, m_seed) & (Size - 1)];
+    const std::size_t slot =
+        displacement < 0 ? static_cast<std::size_t>(-displacement - 1)
+                         : hash(name, static_cast<std::uint64_t>(displacement)) & (Size - 1);
+    const std::size_t index = m_slots[slot];
+    if (index == Empty || m_variables[index].name != name) {
+      return N;
+    }
+    return index;
+  }
+
+  [[nodiscard]] constexpr auto contains(std::string_view name) const -> bool {
+    return index(name) != N;
+  }
+
+  [[nodiscard]] constexpr auto operator[](std::size_t index) const -> const EnvVariable& {
+    return m_variables[index];
+  }
+
+  [[nodiscard]] constexpr auto begin() const -> const EnvVariable* { return m_variables.data(); }
+
+  [[nodiscard]] constexpr auto end() const -> const EnvVariable* {
+    return m_variables.data() + N;
+  }
+
+  /**
+   * @return The raw value from the environment, if set
+   */
+  [[nodiscard]] auto value(std::string_view name) const -> std::optional<std::string> {
+    const std::size_t i = index(name);
+    if (i == N) {
+      notRegistered(name);
+      return {};
+    }
+
+    const char* raw = resolved().values[i].raw;
+    if (raw == nullptr) {
+      return {};
+    }
+    return std::string(raw);
+  }
+
+  /**
+   * @return The value from the environment or the registered default value
+   *
+   * T has to match the registered type: bool for EnvType::Bool, a signed
+   * integer for EnvType::Int, an unsigned integer for EnvType::UInt, a
+   * floating point type for EnvType::Double and std::string, std::string_view
+   * or const char* for EnvType::String.
+   */
+  template <typename T>
+  [[nodiscard]] auto get(std::string_view name) const -> T {
+    static_assert(std::is_arithmetic_v<T> || std::is_same_v<T, std::string> ||
+                      std::is_same_v<T, std::string_view> || std::is_same_v<T, const char*>,
+                  "Unsupported type for an environment variable");
+
+    const std::size_t i = index(name);
+    if (i == N) {
+      notRegistered(name);
+      return T();
+    }
+    if (m_variables[i].type != typeOf<T>()) {
+      logError() << "Environment variable" << std::string(m_prefix) + std::string(name)
+                 << "has type" << std::string(typeName(m_variables[i].type)) << "not"
+                 << std::string(typeName(typeOf<T>()));
+      return T();
+    }
+
+    const Value& value = resolved().values[i];
+    if constexpr (std::is_same_v<T, bool>) {
+      return value.boolValue;
+    } else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>) {
+      return static_cast<T>(value.intValue);
+    } else if constexpr (std::is_integral_v<T>) {
+      return static_cast<T>(value.uintValue);
+    } else if constexpr (std::is_floating_point_v<T>) {
+      return static_cast<T>(value.doubleValue);
+    } else if constexpr (std::is_same_v<T, const char*>) {
+      // Points into the snapshot (never freed) or to the default value
+      return value.stringValue.data();
+    } else {
+      return T(value.stringValue);
+    }
+  }
+
+  /**
+   * Writes all registered variables with their effective value
+   *
+   * Each line has the form
+   * <code>NAME=value # (type, set|default, default defaultValue) description</code>
+   */
+  void dump(std::ostream& out) const {
+    const Resolved& values = resolved();
+    for (std::size_t i = 0; i < N; i++) {
+      const EnvVariable& var = m_variables[i];
+      const char* raw = values.values[i].raw;
+      const std::string_view value = raw != nullptr ? std::string_view(raw) : var.defaultValue;
+      out << m_prefix << var.name << '=' << value << " # (" << typeName(var.type) << ", "
+          << (raw != nullptr ? "set" : "default")
+          << ", default " << var.defaultValue << ") " << var.description << '\n';
+    }
+  }
+
+  static constexpr auto typeName(EnvType type) -> std::string_view {
+    switch (type) {
+    case EnvType::Bool:
+      return "bool";
+    case EnvType::Int:
+      return "int";
+    case EnvType::UInt:
+      return "unsigned int";
+    case EnvType::Double:
+      return "double";
+    case EnvType::String:
+      return "string";
+    }
+    return "unknown";
+  }
+
+  private:
+  void notRegistered(std::string_view name) const {
+    logError() << "Environment variable" << std::string(m_prefix) + std::string(name)
+               << "is not registered";
+  }
+
+  /**
+   * @return The registered type that matches T
+   */
+  template <typename T>
+  static constexpr auto typeOf() -> EnvType {
+    if constexpr (std::is_same_v<T, bool>) {
+      return EnvType::Bool;
+    } else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>) {
+      return EnvType::Int;
+    } else if constexpr (std::is_integral_v<T>) {
+      return EnvType::UInt;
+    } else if constexpr (std::is_floating_point_v<T>) {
+      return EnvType::Double;
+    } else {
+      return EnvType::String;
+    }
+  }
+
+  /**
+   * @return The values for the current snapshot
+   */
+  auto resolved() const -> const Resolved& {
+    const EnvSnapshot::Table& table = EnvSnapshot::get();
+    const Resolved* current = m_resolved.load(std::memory_order_acquire);
+    if (current != nullptr && current->table == &table) {
+      return *current;
+    }
+
+    auto* next = new Resolved{&table, {}, current};
+    const auto [first, last] = table.range(m_prefix);
+    for (std::size_t i = 0; i < N; i++) {
+      const EnvVariable& var = m_variables[i];
+      next->values[i] =
+          resolve(var, EnvSnapshot::Table::find(first, last, m_prefix.size(), var.name));
+    }
+
+    // Another thread might have resolved the values concurrently
+    while (!m_resolved.compare_exchange_weak(
+        current, next, std::memory_order_acq_rel, std::memory_order_acquire)) {
+      if (current != nullptr && current->table == &table) {
+        delete next;
+        return *current;
+      }
+      next->previous = current;
+    }
+    return *next;
+  }
+
+  /**
+   * Parses the value of a variable
+   *
+   * Invalid values are replaced by the default value.
+   */
+  auto resolve(const EnvVariable& var, const char* raw) const -> Value {
+    Value value;
+    value.raw = raw;
+    if (raw == nullptr || !parseValue(var.type, raw, value)) {
+      if (raw != nullptr) {
+        logWarning() << "Ignoring invalid value" << std::string(raw) << "of type"
+                     << std::string(typeName(var.type)) << "for environment variable"
+                     << std::string(m_prefix) + std::string(var.name);
+      }
+      parseValue(var.type, var.defaultValue, value);
+    }
+    return value;
+  }
+
+  /**
+   * @return False if str is not a valid value of the type
+   */
+  static auto parseValue(EnvType type, std::string_view str, Value& value) -> bool {
+    switch (type) {
+    case EnvType::Bool: {
+      const std::string_view s = StringUtils::trimView(str);
+      if (StringUtils::equalsIgnoreCase(s, "on") || StringUtils::equalsIgnoreCase(s, "yes") ||
+          StringUtils::equalsIgnoreCase(s, "true") || s == "1") {
+        value.boolValue = true;
+        return true;
+      }
+      if (StringUtils::equalsIgnoreCase(s, "off") || StringUtils::equalsIgnoreCase(s, "no") ||
+          StringUtils::equalsIgnoreCase(s, "false") || s == "0") {
+        value.boolValue = false;
+        return true;
+      }
+      return false;
+    }
+    case EnvType::Int:
+      return StringUtils::parseNumber(str, value.intValue);
+    case EnvType::UInt:
+      return StringUtils::parseNumber(str, value.uintValue);
+    case EnvType::Double:
+      return StringUtils::parseNumber(str, value.doubleValue);
+    case EnvType::String:
+      value.stringValue = str;
+      return true;
+    }
+    return false;
+  }
+
+  /**
+   * FNV-1a
+   */
+  static constexpr auto hash(std::string_view str, std::uint64_t seed) -> std::uint64_t {
+    std::uint64_t h = 14695981039346656037ULL ^ (seed * 0x9E3779B97F4A7C15ULL);
+    for (const char c : str) {
+      h ^= static_cast<unsigned char>(c);
+      h *= 1099511628211ULL;
+    }
+    return h ^ (h >> 32);
+  }
+
+  /**
+   * Tries to build the tables with the current seed
+   *
+   * @return False if the seed leads to a bucket that cannot be placed
+   */
+  constexpr auto build() -> bool {
+    std::array<std::size_t, Size> bucketSize{};
+    std::array<std::size_t, N> bucket{};
+    for (std::size_t i = 0; i < N; i++) {
+      bucket[i] = hash(m_variables[i].name, m_seed) & (Size - 1);
+      bucketSize[bucket[i]]++;
+    }
+
+    for (std::size_t i = 0; i < Size; i++) {
+      m_slots[i] = Empty;
+      m_displacement[i] = 0;
+    }
+
+    // Place large buckets first, they are the hardest to place
+    for (std::size_t size = N; size > 1; size--) {
+      for (std::size_t b = 0; b < Size; b++) {
+        if (bucketSize[b] == size && !placeBucket(bucket, b)) {
+          return false;
+        }
+      }
+    }
+
+    // Put single names into any free slot
+    std::size_t freeSlot = 0;
+    for (std::size_t i = 0; i < N; i++) {
+      if (bucketSize[bucket[i]] == 1) {
+        while (m_slots[freeSlot] != Empty) {
+          freeSlot++;
+        }
+        m_slots[freeSlot] = i;
+        m_displacement[bucket[i]] = -static_cast<std::int64_t>(freeSlot) - 1;
+      }
+    }
+
+    return true;
+  }
+
+  /**
+   * Searches a displacement that maps all names of bucket b to free slots
+   */
+  constexpr auto placeBucket(const std::array<std::size_t, N>& bucket, std::size_t b) -> bool {
+    for (std::int64_t displacement = 1; displacement <= 4 * static_cast<std::int64_t>(Size);
+         displacement++) {
+      std::array<std::size_t, Size> slots{};
+      std::size_t count = 0;
+      bool valid = true;
+      for (std::size_t i = 0; i < N && valid; i++) {
+        if (bucket[i] != b) {
+          continue;
+        }
+        const std::size_t slot =
+            hash(m_variables[i].name, static_cast<std::uint64_t>(displacement)) & (Size - 1);
+        valid = m_slots[slot] == Empty;
+        for (std::size_t j = 0; j < count && valid; j++) {
+          valid = slots[j] != slot;
+        }
+        slots[count++] = slot;
+      }
+
+      if (valid) {
+        count = 0;
+        for (std::size_t i = 0; i < N; i++) {
+          if (bucket[i] == b) {
+            m_slots[slots[count++]] = i;
+          }
+        }
+        m_displacement[b] = displacement;
+        return true;
+      }
+    }
+
+    return false;
+  }
+};
+
+template <std::size_t N>
+EnvRegistry(std::string_view, const EnvVariable (&)[N]) -> EnvRegistry<N>;
+
+} // namespace utils
+
+#endif // UTILS_ENVREGISTRY_H_
@@ -7,6 +7,29 @@
 #ifndef UTILS_MATHUTILS_H_
 #define UTILS_MATHUTILS_H_
 
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif // __BMI2__
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif // _OPENMP
+
 namespace utils {
 
 /**
@@ -20,26 +43,1023 @@ class MathUtils {
    * a and k should be of kind "int".
    */
   template <typename T>
-  static auto roundUp(T a, T k) -> T {
+  static constexpr auto roundUp(T a, T k) -> T {
     return ((a + k - 1) / k) * k;
   }
 
+  /**
+   * Finds the smallest value x >= a such that x % K == 0
+   *
+   * Uses a mask if K is a power of two. Use InvariantDivisor if k is only
+   * known at runtime but used several times.
+   */
+  template <auto K, typename T>
+  static constexpr auto roundUp(T a) -> T {
+    static_assert(std::is_integral_v<T>, "Only integers are supported");
+    static_assert(K > 0, "K must be positive");
+    constexpr auto k = static_cast<T>(K);
+    if constexpr ((k & (k - 1)) == 0) {
+      return static_cast<T>((a + (k - 1)) & ~(k - 1));
+    } else {
+      return static_cast<T>(((a + k - 1) / k) * k);
+    }
+  }
+
   /**
    * Computes the greatest common divisor of a and b
    *
+   * Uses the binary GCD algorithm (Stein). gcd(a, 0) is |a|.
+   *
    * @param a
    * @param b
    * @return
    */
   template <typename T>
-  static auto gcd(T a, T b) -> T {
-    T c = a % b;
-    while (c != 0) {
-      a = b;
-      b = c;
-      c = a % b;
+  static constexpr auto gcd(T a, T b) -> T {
+    static_assert(std::is_integral_v<T>, "Only integers are supported");
+    using U = std::make_unsigned_t<T>;
+    U u = absolute(a);
+    U v = absolute(b);
+    if (u == 0) {
+      return static_cast<T>(v);
+    }
+    if (v == 0) {
+      return static_cast<T>(u);
+    }
+
+    // Common factors of 2
+    const int shift = countTrailingZeros(u | v);
+    u >>= countTrailingZeros(u);
+    while (v != 0) {
+      v >>= countTrailingZeros(v);
+      if (u > v) {
+        const U t = u;
+        u = v;
+        v = t;
+      }
+      v -= u;
+    }
+    return static_cast<T>(u << shift);
+  }
+
+  /**
+   * Computes the least common multiple of a and b
+   *
+   * lcm(a, 0) is 0.
+   *
+   * @throws std::overflow_error If the result does not fit into T
+   */
+  template <typename T>
+  static constexpr auto lcm(T a, T b) -> T {
+    static_assert(std::is_integral_v<T>, "Only integers are supported");
+    if (a == 0 || b == 0) {
+      return 0;
+    }
+    using U = std::make_unsigned_t<T>;
+    const U u = absolute(a) / static_cast<U>(gcd(a, b));
+    const U v = absolute(b);
+    if (u > static_cast<U>(std::numeric_limits<T>::max()) / v) {
+      throw std::overflow_error("Least common multiple does not fit into the type");
     }
-    return b;
+    return static_cast<T>(u * v);
+  }
+
+  /**
+   * Computes the greatest common divisor of all values in [first, last)
+   *
+   * Four independent reductions are interleaved, so the compiler can
+   * overlap them. Stops early once the result is 1.
+   *
+   * @return 0 for an empty range
+   */
+  template <typename Iterator>
+  static constexpr auto gcdRange(Iterator first, Iterator last) ->
+      typename std::iterator_traits<Iterator>::value_type {
+    using T = typename std::iterator_traits<Iterator>::value_type;
+    T result[4] = {0, 0, 0, 0};
+    while (first != last) {
+      for (int i = 0; i < 4 && first != last; i++, ++first) {
+        result[i] = gcd(result[i], *first);
+      }
+      if (result[0] == 1 || result[1] == 1 || result[2] == 1 || result[3] == 1) {
+        return 1;
+      }
+    }
+    return gcd(gcd(result[0], result[1]), gcd(result[2], result[3]));
+  }
+
+  /**
+   * Computes the least common multiple of all values in [first, last)
+   *
+   * @return 1 for an empty range
+   * @throws std::overflow_error If the result does not fit into the value type
+   */
+  template <typename Iterator>
+  static constexpr auto lcmRange(Iterator first, Iterator last) ->
+      typename std::iterator_traits<Iterator>::value_type {
+    using T = typename std::iterator_traits<Iterator>::value_type;
+    T result = 1;
+    for (; first != last; ++first) {
+      result = lcm(result, *first);
+    }
+    return result;
+  }
+
+  /**
+   * @return The number of set bits
+   */
+  template <typename U>
+  static constexpr auto popcount(U a) -> int {
+    static_assert(std::is_unsigned_v<U>, "Only unsigned integers are supported");
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_popcountll(a);
+#else
+    int count = 0;
+    for (; a != 0; a &= a - 1) {
+      count++;
+    }
+    return count;
+#endif
+  }
+
+  /**
+   * @return True if a is a power of two (false for 0)
+   */
+  template <typename U>
+  static constexpr auto isPow2(U a) -> bool {
+    static_assert(std::is_unsigned_v<U>, "Only unsigned integers are supported");
+    return a != 0 && (a & (a - 1)) == 0;
+  }
+
+  /**
+   * @return floor(log2(a)) or -1 for 0
+   */
+  template <typename U>
+  static constexpr auto ilog2(U a) -> int {
+    static_assert(std::is_unsigned_v<U>, "Only unsigned integers are supported");
+    if (a == 0) {
+      return -1;
+    }
+    return std::numeric_limits<U>::digits - 1 - countLeadingZeros(a);
+  }
+
+  /**
+   * @return ceil(log2(a)) or 0 for 0
+   */
+  template <typename U>
+  static constexpr auto ceilLog2(U a) -> int {
+    static_assert(std::is_unsigned_v<U>, "Only unsigned integers are supported");
+    if (a <= 1) {
+      return 0;
+    }
+    return ilog2(static_cast<U>(a - 1)) + 1;
+  }
+
+  /**
+   * @return The smallest power of two >= a (1 for 0) or 0 if it does not fit into U
+   */
+  template <typename U>
+  static constexpr auto nextPow2(U a) -> U {
+    static_assert(std::is_unsigned_v<U>, "Only unsigned integers are supported");
+    const int shift = ceilLog2(a);
+    if (shift >= std::numeric_limits<U>::digits) {
+      return 0;
+    }
+    return static_cast<U>(static_cast<U>(1) << shift);
+  }
+
+  /**
+   * Rounds a up to a multiple of alignment
+   *
+   * @param alignment Must be a power of two
+   * @return The aligned value or 0 if it does not fit into U
+   */
+  template <typename U>
+  static constexpr auto alignUp(U a, std::common_type_t<U> alignment) -> U {
+    static_assert(std::is_unsigned_v<U>, "Only unsigned integers are supported");
+    // Wraps around to 0 on overflow
+    return static_cast<U>((a + (alignment - 1)) & ~(alignment - 1));
+  }
+
+  /**
+   * Rounds a down to a multiple of alignment
+   *
+   * @param alignment Must be a power of two
+   */
+  template <typename U>
+  static constexpr auto alignDown(U a, std::common_type_t<U> alignment) -> U {
+    static_assert(std::is_unsigned_v<U>, "Only unsigned integers are supported");
+    return static_cast<U>(a & ~(alignment - 1));
+  }
+
+  /**
+   * Rounds a pointer up to the next address that is a multiple of alignment
+   *
+   * @param alignment Must be a power of two
+   * @return The aligned pointer or nullptr if the address does not fit
+   */
+  template <typename T>
+  static auto alignUp(T* ptr, std::size_t alignment) -> T* {
+    // NOLINTNEXTLINE
+    return reinterpret_cast<T*>(alignUp(reinterpret_cast<std::uintptr_t>(ptr), alignment));
+  }
+
+  /**
+   * Rounds a pointer down to the previous address that is a multiple of alignment
+   *
+   * @param alignment Must be a power of two
+   */
+  template <typename T>
+  static auto alignDown(T* ptr, std::size_t alignment) -> T* {
+    // NOLINTNEXTLINE
+    return reinterpret_cast<T*>(alignDown(reinterpret_cast<std::uintptr_t>(ptr), alignment));
+  }
+
+  /**
+   * Interleaves the bits of x and y (x in the lowest bit)
+   */
+  static auto mortonEncode(std::uint32_t x, std::uint32_t y) -> std::uint64_t {
+    return spreadBits2(x) | (spreadBits2(y) << 1);
+  }
+
+  /**
+   * Interleaves the lower 21 bits of x, y and z (x in the lowest bit)
+   */
+  static auto mortonEncode(std::uint32_t x, std::uint32_t y, std::uint32_t z) -> std::uint64_t {
+    return spreadBits3(x) | (spreadBits3(y) << 1) | (spreadBits3(z) << 2);
+  }
+
+  /**
+   * @return The coordinates (x, y) of a 2D Morton code
+   */
+  static auto mortonDecode2D(std::uint64_t code) -> std::array<std::uint32_t, 2> {
+    return {compactBits2(code), compactBits2(code >> 1)};
+  }
+
+  /**
+   * @return The coordinates (x, y, z) of a 3D Morton code
+   */
+  static auto mortonDecode3D(std::uint64_t code) -> std::array<std::uint32_t, 3> {
+    return {compactBits3(code), compactBits3(code >> 1), compactBits3(code >> 2)};
+  }
+
+  /**
+   * Computes the position on the 3D Hilbert curve
+   *
+   * Uses the algorithm by Skilling ("Programming the Hilbert curve", 2004).
+   *
+   * @param bits Number of bits per coordinate (at most 21)
+   */
+  static auto hilbertIndex(std::uint32_t x, std::uint32_t y, std::uint32_t z, int bits = 21)
+      -> std::uint64_t {
+    for (int level = bits - 1; level > 0; level--) {
+      hilbertUndo(x, y, z, level);
+    }
+    hilbertGray(x, y, z, bits);
+
+    // The transposed index has the most significant bit in x
+    return mortonEncode(z, y, x);
+  }
+
+  /**
+   * Computes the 2D Morton codes of n points
+   */
+  static void mortonEncode(const std::uint32_t* x,
+                           const std::uint32_t* y,
+                           std::uint64_t* codes,
+                           std::size_t n) {
+    for (std::size_t i = 0; i < n; i++) {
+      codes[i] = mortonEncode(x[i], y[i]);
+    }
+  }
+
+  /**
+   * Computes the 3D Morton codes of n points
+   */
+  static void mortonEncode(const std::uint32_t* x,
+                           const std::uint32_t* y,
+                           const std::uint32_t* z,
+                           std::uint64_t* codes,
+                           std::size_t n) {
+    for (std::size_t i = 0; i < n; i++) {
+      codes[i] = mortonEncode(x[i], y[i], z[i]);
+    }
+  }
+
+  /**
+   * Computes the 3D Hilbert indices of n points
+   */
+  static void hilbertIndex(const std::uint32_t* x,
+                           const std::uint32_t* y,
+                           const std::uint32_t* z,
+                           std::uint64_t* codes,
+                           std::size_t n,
+                           int bits = 21) {
+    // Process blocks level by level, so the compiler can vectorize over the points
+    constexpr std::size_t BlockSize = 64;
+    std::uint32_t block[3][BlockSize];
+    for (std::size_t start = 0; start < n; start += BlockSize) {
+      const std::size_t size = std::min(BlockSize, n - start);
+      for (std::size_t i = 0; i < size; i++) {
+        block[0][i] = x[start + i];
+        block[1][i] = y[start + i];
+        block[2][i] = z[start + i];
+      }
+
+      for (int level = bits - 1; level > 0; level--) {
+        for (std::size_t i = 0; i < size; i++) {
+          hilbertUndo(block[0][i], block[1][i], block[2][i], level);
+        }
+      }
+      for (std::size_t i = 0; i < size; i++) {
+        hilbertGray(block[0][i], block[1][i], block[2][i], bits);
+        codes[start + i] = mortonEncode(block[2][i], block[1][i], block[0][i]);
+      }
+    }
+  }
+
+  /**
+   * Computes the permutation that sorts keys (e.g. Morton codes)
+   *
+   * Uses a stable LSD radix sort of 32-bit indices (if n < 2^32) and skips
+   * digits that are equal for all keys. The digits are extracted from keys
+   * in every pass, so apart from the result only 8 bytes per key are
+   * allocated.
+   *
+   * @return perm such that keys[perm[0]] <= keys[perm[1]] <= ...
+   */
+  static auto sortPermutation(const std::uint64_t* keys, std::size_t n)
+      -> std::vector<std::size_t> {
+    if (n <= std::numeric_limits<std::uint32_t>::max()) {
+      const std::vector<std::uint32_t> permutation = sortIndices<std::uint32_t>(keys, n);
+      return std::vector<std::size_t>(permutation.begin(), permutation.end());
+    }
+    return sortIndices<std::size_t>(keys, n);
+  }
+
+  /**
+   * Splits n items into parts contiguous blocks
+   *
+   * The first n % parts blocks get one additional item.
+   *
+   * @param n Must not be negative
+   * @param parts Must be positive
+   * @param part Must be in [0, parts)
+   * @return The range [begin, end) of the block part
+   */
+  template <typename T>
+  static constexpr auto blockRange(T n, T parts, T part) -> std::pair<T, T> {
+    static_assert(std::is_integral_v<T>, "Only integers are supported");
+    assert(n >= 0 && parts > 0 && part >= 0 && part < parts);
+    const T size = n / parts;
+    const T remainder = n % parts;
+    const T begin = part * size + std::min(part, remainder);
+    return {begin, begin + size + (part < remainder ? 1 : 0)};
+  }
+
+  /**
+   * @param parts Must be positive
+   * @param index Must be in [0, n)
+   * @return The block (see blockRange()) that contains index
+   */
+  template <typename T>
+  static constexpr auto blockOwner(T n, T parts, T index) -> T {
+    static_assert(std::is_integral_v<T>, "Only integers are supported");
+    assert(parts > 0 && index >= 0 && index < n);
+    const T size = n / parts;
+    const T remainder = n % parts;
+    // Items in the larger blocks
+    const T large = remainder * (size + 1);
+    if (index < large) {
+      return index / (size + 1);
+    }
+    return remainder + (index - large) / size;
+  }
+
+  /**
+   * Splits items with the given costs into parts contiguous chunks such that
+   * the largest sum of costs in a chunk is minimal
+   *
+   * Computes a prefix sum of the costs (in parallel with OpenMP) and
+   * searches the smallest feasible bottleneck with a bisection. Each test
+   * places the chunks greedily with binary searches in the prefix sum. The
+   * result is optimal up to the floating point precision.
+   *
+   * @param costs Must not be negative
+   * @param parts Must be positive
+   * @return parts + 1 boundaries; chunk i is [result[i], result[i+1]).
+   *  Trailing chunks can be empty.
+   */
+  template <typename T>
+  static auto partitionWeighted(const T* costs, std::size_t n, std::size_t parts)
+      -> std::vector<std::size_t> {
+    static_assert(std::is_arithmetic_v<T>, "Only numbers are supported");
+    std::vector<double> prefix(n + 1);
+    prefixSum(costs, n, prefix.data());
+
+    double maxCost = 0;
+    for (std::size_t i = 0; i < n; i++) {
+      maxCost = std::max(maxCost, static_cast<double>(costs[i]));
+    }
+
+    std::vector<std::size_t> boundaries(parts + 1);
+    // The optimal bottleneck is in [max(average, maximum), average + maximum]
+    const double average = prefix[n] / parts;
+    double low = std::max(average, maxCost);
+    double high = average + maxCost;
+    if (!placeChunks(prefix, high, boundaries)) {
+      // Only possible due to rounding
+      high = prefix[n];
+    }
+    for (int i = 0; i < 64 && low < high; i++) {
+      const double middle = low + (high - low) / 2;
+      if (middle <= low || middle >= high) {
+        break;
+      }
+      if (placeChunks(prefix, middle, boundaries)) {
+        high = middle;
+      } else {
+        low = middle;
+      }
+    }
+    if (!placeChunks(prefix, low, boundaries)) {
+      placeChunks(prefix, high, boundaries);
+    }
+    return boundaries;
+  }
+
+  /**
+   * Sums values with pairwise summation
+   *
+   * The error grows with O(log n) instead of O(n) for naive summation at
+   * almost the same speed. The innermost blocks are summed with several
+   * independent accumulators, which the compiler can map to SIMD registers.
+   */
+  template <typename T>
+  static auto pairwiseSum(const T* values, std::size_t n) -> T {
+    return pairwiseReduce<T>(0, n, [values](std::size_t i) { return values[i]; });
+  }
+
+  /**
+   * Sums values with Neumaier's variant of Kahan summation (Kahan-Babuska)
+   *
+   * The error does not depend on n (unless the condition number is very
+   * large). Uses several independent accumulators, so the compiler can
+   * vectorize the loop.
+   */
+  template <typename T>
+  static auto compensatedSum(const T* values, std::size_t n) -> T {
+    return compensatedReduce<T>(0, n, [values](std::size_t i) { return values[i]; });
+  }
+
+  /**
+   * Computes the dot product with pairwise summation
+   */
+  template <typename T>
+  static auto dot(const T* a, const T* b, std::size_t n) -> T {
+    return pairwiseReduce<T>(0, n, [a, b](std::size_t i) { return a[i] * b[i]; });
+  }
+
+  /**
+   * Computes the dot product with compensated summation
+   *
+   * With hardware FMA support, the rounding errors of the products are
+   * compensated as well (Ogita, Rump and Oishi, "Accurate sum and dot
+   * product", 2005).
+   */
+  template <typename T>
+  static auto compensatedDot(const T* a, const T* b, std::size_t n) -> T {
+    return compensatedDotRange(a, b, 0, n);
+  }
+
+  /**
+   * @return The sum of the absolute values (compensated)
+   */
+  template <typename T>
+  static auto norm1(const T* values, std::size_t n) -> T {
+    return compensatedReduce<T>(0, n, [values](std::size_t i) { return std::abs(values[i]); });
+  }
+
+  /**
+   * @return The Euclidean norm (compensated); the squares must not overflow
+   */
+  template <typename T>
+  static auto norm2(const T* values, std::size_t n) -> T {
+    return std::sqrt(compensatedDot(values, values, n));
+  }
+
+  /**
+   * @return The largest absolute value
+   */
+  template <typename T>
+  static auto normInf(const T* values, std::size_t n) -> T {
+    T lanes[ReductionLanes] = {};
+    std::size_t i = 0;
+    for (; i + ReductionLanes <= n; i += ReductionLanes) {
+      for (std::size_t j = 0; j < ReductionLanes; j++) {
+        lanes[j] = std::max(lanes[j], std::abs(values[i + j]));
+      }
+    }
+    for (; i < n; i++) {
+      lanes[0] = std::max(lanes[0], std::abs(values[i]));
+    }
+    return *std::max_element(lanes, lanes + ReductionLanes);
+  }
+
+  /**
+   * Sums values with several threads
+   *
+   * The values are split into blocks of ParallelBlockSize which are summed
+   * with compensatedSum(). The results of the blocks are combined in a fixed
+   * order, so the result is bitwise identical for any number of threads.
+   *
+   * @param threads Number of threads (0 for the number of cores)
+   */
+  template <typename T>
+  static auto parallelSum(const T* values, std::size_t n, unsigned int threads = 0) -> T {
+    return parallelReduce<T>(n, threads, [values](std::size_t begin, std::size_t end) {
+      return compensatedReduce<T>(begin, end, [values](std::size_t i) { return values[i]; });
+    });
+  }
+
+  /**
+   * Computes the dot product with several threads
+   *
+   * Like parallelSum(), the result does not depend on the number of threads.
+   */
+  template <typename T>
+  static auto parallelDot(const T* a, const T* b, std::size_t n, unsigned int threads = 0) -> T {
+    return parallelReduce<T>(n, threads, [a, b](std::size_t begin, std::size_t end) {
+      return compensatedDotRange(a, b, begin, end);
+    });
+  }
+
+  /** Number of independent accumulators in reductions */
+  static constexpr std::size_t ReductionLanes = 8;
+
+  /** Size of the blocks that are summed directly in pairwiseSum() */
+  static constexpr std::size_t PairwiseBlockSize = 256;
+
+  /** Number of values per block in parallel reductions */
+  static constexpr std::size_t ParallelBlockSize = 1 << 16;
+
+  private:
+  /**
+   * Radix sort for sortPermutation() with indices of type I
+   */
+  template <typename I>
+  static auto sortIndices(const std::uint64_t* keys, std::size_t n) -> std::vector<I> {
+    constexpr int DigitBits = 11;
+    constexpr std::size_t Buckets = 1U << DigitBits;
+    constexpr int Digits = (64 + DigitBits - 1) / DigitBits;
+
+    // The histograms of all digits do not depend on the order, count them in one pass
+    std::vector<std::size_t> offsets(Digits * Buckets);
+    std::uint64_t differing = 0;
+    for (std::size_t i = 0; i < n; i++) {
+      const std::uint64_t key = keys[i];
+      differing |= key ^ keys[0];
+      for (int digit = 0; digit < Digits; digit++) {
+        offsets[digit * Buckets + ((key >> (digit * DigitBits)) & (Buckets - 1))]++;
+      }
+    }
+
+    std::vector<I> permutation(n);
+    for (std::size_t i = 0; i < n; i++) {
+      permutation[i] = static_cast<I>(i);
+    }
+
+    std::vector<I> buffer;
+    for (int digit = 0; digit < Digits; digit++) {
+      const int shift = digit * DigitBits;
+      if (((differing >> shift) & (Buckets - 1)) == 0) {
+        continue;
+      }
+      buffer.resize(n);
+
+      std::size_t* offset = offsets.data() + digit * Buckets;
+      std::size_t sum = 0;
+      for (std::size_t bucket = 0; bucket < Buckets; bucket++) {
+        const std::size_t count = offset[bucket];
+        offset[bucket] = sum;
+        sum += count;
+      }
+      for (const I index : permutation) {
+        buffer[offset[(keys[index] >> shift) & (Buckets - 1)]++] = index;
+      }
+      permutation.swap(buffer);
+    }
+
+    return permutation;
+  }
+
+  /**
+   * Sums load(i) for i in [begin, end) with pairwise summation
+   */
+  template <typename T, typename F>
+  static auto pairwiseReduce(std::size_t begin, std::size_t end, const F& load) -> T {
+    const std::size_t n = end - begin;
+    if (n > PairwiseBlockSize) {
+      const std::size_t half = begin + (n / 2) / ReductionLanes * ReductionLanes;
+      return pairwiseReduce<T>(begin, half, load) + pairwiseReduce<T>(half, end, load);
+    }
+
+    T lanes[ReductionLanes] = {};
+    std::size_t i = begin;
+    for (; i + ReductionLanes <= end; i += ReductionLanes) {
+      for (std::size_t j = 0; j < ReductionLanes; j++) {
+        lanes[j] += load(i + j);
+      }
+    }
+    for (; i < end; i++) {
+      lanes[0] += load(i);
+    }
+    return combineLanes(lanes);
+  }
+
+  /**
+   * Sums load(i) for i in [begin, end) with compensated summation
+   */
+  template <typename T, typename F>
+  static auto compensatedReduce(std::size_t begin, std::size_t end, const F& load) -> T {
+    T sums[ReductionLanes] = {};
+    T compensations[ReductionLanes] = {};
+    std::size_t i = begin;
+    for (; i + ReductionLanes <= end; i += ReductionLanes) {
+      for (std::size_t j = 0; j < ReductionLanes; j++) {
+        neumaierAdd(sums[j], compensations[j], load(i + j));
+      }
+    }
+    for (; i < end; i++) {
+      neumaierAdd(sums[0], compensations[0], load(i));
+    }
+    return combineLanes(sums, compensations);
+  }
+
+  template <typename T>
+  static auto compensatedDotRange(const T* a, const T* b, std::size_t begin, std::size_t end)
+      -> T {
+#ifdef __FMA__
+    T sums[ReductionLanes] = {};
+    T compensations[ReductionLanes] = {};
+    std::size_t i = begin;
+    for (; i + ReductionLanes <= end; i += ReductionLanes) {
+      for (std::size_t j = 0; j < ReductionLanes; j++) {
+        const T product = a[i + j] * b[i + j];
+        // Exact rounding error of the product
+        compensations[j] += std::fma(a[i + j], b[i + j], -product);
+        neumaierAdd(sums[j], compensations[j], product);
+      }
+    }
+    for (; i < end; i++) {
+      const T product = a[i] * b[i];
+      compensations[0] += std::fma(a[i], b[i], -product);
+      neumaierAdd(sums[0], compensations[0], product);
+    }
+    return combineLanes(sums, compensations);
+#else
+    return compensatedReduce<T>(begin, end, [a, b](std::size_t i) { return a[i] * b[i]; });
+#endif // __FMA__
+  }
+
+  /**
+   * Adds x to sum and the rounding error to compensation
+   */
+  template <typename T>
+  static void neumaierAdd(T& sum, T& compensation, T x) {
+    const T t = sum + x;
+    compensation += std::abs(sum) >= std::abs(x) ? (sum - t) + x : (x - t) + sum;
+    sum = t;
+  }
+
+  /**
+   * Sums the lanes pairwise
+   */
+  template <typename T>
+  static auto combineLanes(T (&lanes)[ReductionLanes]) -> T {
+    for (std::size_t width = ReductionLanes / 2; width > 0; width /= 2) {
+      for (std::size_t j = 0; j < width; j++) {
+        lanes[j] += lanes[j + width];
+      }
+    }
+    return lanes[0];
+  }
+
+  template <typename T>
+  static auto combineLanes(const T (&sums)[ReductionLanes],
+                           const T (&compensations)[ReductionLanes]) -> T {
+    T sum = 0;
+    T compensation = 0;
+    for (std::size_t j = 0; j < ReductionLanes; j++) {
+      neumaierAdd(sum, compensation, sums[j]);
+      compensation += compensations[j];
+    }
+    return sum + compensation;
+  }
+
+  /**
+   * Reduces blocks of ParallelBlockSize values with reduceBlock(begin, end)
+   * and sums the results in a fixed order
+   */
+  template <typename T, typename F>
+  static auto parallelReduce(std::size_t n, unsigned int threads, const F& reduceBlock) -> T {
+    const std::size_t blocks = (n + ParallelBlockSize - 1) / ParallelBlockSize;
+    if (threads == 0) {
+      threads = std::max(std::thread::hardware_concurrency(), 1U);
+    }
+    threads = static_cast<unsigned int>(std::min<std::size_t>(threads, blocks));
+
+    std::vector<T> results(blocks);
+    const auto work = [&](unsigned int thread) {
+      for (std::size_t block = thread; block < blocks; block += threads) {
+        const std::size_t begin = block * ParallelBlockSize;
+        results[block] = reduceBlock(begin, std::min(begin + ParallelBlockSize, n));
+      }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned int thread = 1; thread < threads; thread++) {
+      workers.emplace_back(work, thread);
+    }
+    work(0);
+    for (auto& worker : workers) {
+      worker.join();
+    }
+
+    return compensatedSum(results.data(), blocks);
+  }
+
+  /**
+   * Computes prefix[i] = costs[0] + ... + costs[i-1] for i = 0..n
+   */
+  template <typename T>
+  static void prefixSum(const T* costs, std::size_t n, double* prefix) {
+    prefix[0] = 0;
+#ifdef _OPENMP
+    // Two passes: sum of each block, then the prefix sum inside the blocks
+    std::vector<double> blockSums;
+#pragma omp parallel if (n > 65536)
+    {
+      const auto threads = static_cast<std::size_t>(omp_get_num_threads());
+      const auto thread = static_cast<std::size_t>(omp_get_thread_num());
+#pragma omp single
+      blockSums.assign(threads + 1, 0);
+
+      const auto [begin, end] = blockRange(n, threads, thread);
+      double sum = 0;
+      for (std::size_t i = begin; i < end; i++) {
+        sum += costs[i];
+      }
+      blockSums[thread + 1] = sum;
+#pragma omp barrier
+#pragma omp single
+      for (std::size_t t = 0; t < threads; t++) {
+        blockSums[t + 1] += blockSums[t];
+      }
+
+      sum = blockSums[thread];
+      for (std::size_t i = begin; i < end; i++) {
+        sum += costs[i];
+        prefix[i + 1] = sum;
+      }
+    }
+#else
+    double sum = 0;
+    for (std::size_t i = 0; i < n; i++) {
+      sum += costs[i];
+      prefix[i + 1] = sum;
+    }
+#endif // _OPENMP
+  }
+
+  /**
+   * Places the chunks greedily such that no chunk is larger than bottleneck
+   *
+   * @return False if not all items fit into the chunks
+   */
+  static auto placeChunks(const std::vector<double>& prefix,
+                          double bottleneck,
+                          std::vector<std::size_t>& boundaries) -> bool {
+    const std::size_t n = prefix.size() - 1;
+    boundaries[0] = 0;
+    for (std::size_t part = 1; part < boundaries.size(); part++) {
+      const std::size_t begin = boundaries[part - 1];
+      // The last end with prefix[end] - prefix[begin] <= bottleneck
+      const auto end = std::upper_bound(prefix.begin() + static_cast<std::ptrdiff_t>(begin),
+                                        prefix.end(),
+                                        prefix[begin] + bottleneck) -
+                       prefix.begin() - 1;
+      boundaries[part] = static_cast<std::size_t>(end);
+    }
+    return boundaries.back() == n;
+  }
+
+  /**
+   * One level of the inverse undo step of the Hilbert transform (without
+   * branches, they are hard to predict)
+   */
+  static void hilbertUndo(std::uint32_t& x, std::uint32_t& y, std::uint32_t& z, int level) {
+    const std::uint32_t p = (1U << level) - 1;
+    x ^= p & (0U - ((x >> level) & 1));
+    for (std::uint32_t* axis : {&y, &z}) {
+      // All bits set if the bit of the level is set in the axis
+      const std::uint32_t invert = 0U - ((*axis >> level) & 1);
+      x ^= p & invert;
+      const std::uint32_t t = (x ^ *axis) & p & ~invert;
+      x ^= t;
+      *axis ^= t;
+    }
+  }
+
+  /**
+   * Gray encoding step of the Hilbert transform
+   */
+  static void hilbertGray(std::uint32_t& x, std::uint32_t& y, std::uint32_t& z, int bits) {
+    y ^= x;
+    z ^= y;
+    std::uint32_t t = 0;
+    for (int level = bits - 1; level > 0; level--) {
+      t ^= ((1U << level) - 1) & (0U - ((z >> level) & 1));
+    }
+    x ^= t;
+    y ^= t;
+    z ^= t;
+  }
+
+  template <typename T>
+  static constexpr auto absolute(T a) -> std::make_unsigned_t<T> {
+    using U = std::make_unsigned_t<T>;
+    if constexpr (std::is_signed_v<T>) {
+      // Also works for the smallest value
+      return a < 0 ? static_cast<U>(0) - static_cast<U>(a) : static_cast<U>(a);
+    } else {
+      return a;
+    }
+  }
+
+  /**
+   * @param a Must not be 0
+   */
+  template <typename U>
+  static constexpr auto countTrailingZeros(U a) -> int {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(a);
+#else
+    int count = 0;
+    while ((a & 1) == 0) {
+      a >>= 1;
+      count++;
+    }
+    return count;
+#endif
+  }
+
+  /**
+   * @param a Must not be 0
+   */
+  template <typename U>
+  static constexpr auto countLeadingZeros(U a) -> int {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_clzll(a) - (std::numeric_limits<unsigned long long>::digits -
+                                 std::numeric_limits<U>::digits);
+#else
+    int count = std::numeric_limits<U>::digits;
+    for (; a != 0; a >>= 1) {
+      count--;
+    }
+    return count;
+#endif
+  }
+
+  /**
+   * Moves bit i of a to bit 2i
+   */
+  static auto spreadBits2(std::uint64_t a) -> std::uint64_t {
+#ifdef __BMI2__
+    return _pdep_u64(a, 0x5555555555555555ULL);
+#else
+    a &= 0xFFFFFFFFULL;
+    a = (a | (a << 16)) & 0x0000FFFF0000FFFFULL;
+    a = (a | (a << 8)) & 0x00FF00FF00FF00FFULL;
+    a = (a | (a << 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    a = (a | (a << 2)) & 0x3333333333333333ULL;
+    a = (a | (a << 1)) & 0x5555555555555555ULL;
+    return a;
+#endif
+  }
+
+  /**
+   * Inverse of spreadBits2
+   */
+  static auto compactBits2(std::uint64_t a) -> std::uint32_t {
+#ifdef __BMI2__
+    return static_cast<std::uint32_t>(_pext_u64(a, 0x5555555555555555ULL));
+#else
+    a &= 0x5555555555555555ULL;
+    a = (a | (a >> 1)) & 0x3333333333333333ULL;
+    a = (a | (a >> 2)) & 0x0F0F0F0F0F0F0F0FULL;
+    a = (a | (a >> 4)) & 0x00FF00FF00FF00FFULL;
+    a = (a | (a >> 8)) & 0x0000FFFF0000FFFFULL;
+    a = (a | (a >> 16)) & 0xFFFFFFFFULL;
+    return static_cast<std::uint32_t>(a);
+#endif
+  }
+
+  /**
+   * Moves bit i of a to bit 3i (for the lower 21 bits)
+   */
+  static auto spreadBits3(std::uint64_t a) -> std::uint64_t {
+#ifdef __BMI2__
+    return _pdep_u64(a, 0x1249249249249249ULL);
+#else
+    a &= 0x1FFFFFULL;
+    a = (a | (a << 32)) & 0x001F00000000FFFFULL;
+    a = (a | (a << 16)) & 0x001F0000FF0000FFULL;
+    a = (a | (a << 8)) & 0x100F00F00F00F00FULL;
+    a = (a | (a << 4)) & 0x10C30C30C30C30C3ULL;
+    a = (a | (a << 2)) & 0x1249249249249249ULL;
+    return a;
+#endif
+  }
+
+  /**
+   * Inverse of spreadBits3
+   */
+  static auto compactBits3(std::uint64_t a) -> std::uint32_t {
+#ifdef __BMI2__
+    return static_cast<std::uint32_t>(_pext_u64(a, 0x1249249249249249ULL));
+#else
+    a &= 0x1249249249249249ULL;
+    a = (a | (a >> 2)) & 0x10C30C30C30C30C3ULL;
+    a = (a | (a >> 4)) & 0x100F00F00F00F00FULL;
+    a = (a | (a >> 8)) & 0x001F0000FF0000FFULL;
+    a = (a | (a >> 16)) & 0x001F00000000FFFFULL;
+    a = (a | (a >> 32)) & 0x1FFFFFULL;
+    return static_cast<std::uint32_t>(a);
+#endif
+  }
+};
+
+/**
+ * A 32 bit divisor that is used many times
+ *
+ * Division and modulo are replaced by multiplications with a precomputed
+ * 64 bit reciprocal (Lemire et al., "Faster remainder by direct computation",
+ * 2019). Falls back to the division instruction if the compiler does not
+ * support 128 bit integers.
+ */
+class InvariantDivisor {
+  private:
+  std::uint32_t m_divisor;
+
+  /** ceil(2^64 / divisor), 0 for divisor 1 */
+  std::uint64_t m_multiplier;
+
+  public:
+  /**
+   * @param divisor Must not be 0
+   */
+  constexpr explicit InvariantDivisor(std::uint32_t divisor)
+      : m_divisor(divisor), m_multiplier(UINT64_MAX / divisor + 1) {}
+
+  [[nodiscard]] constexpr auto divisor() const -> std::uint32_t { return m_divisor; }
+
+  /**
+   * @return a / divisor()
+   */
+  [[nodiscard]] constexpr auto divide(std::uint32_t a) const -> std::uint32_t {
+#ifdef __SIZEOF_INT128__
+    if (m_multiplier == 0) {
+      return a;
+    }
+    return static_cast<std::uint32_t>((static_cast<unsigned __int128>(m_multiplier) * a) >> 64);
+#else
+    return a / m_divisor;
+#endif
+  }
+
+  /**
+   * @return a % divisor()
+   */
+  [[nodiscard]] constexpr auto modulo(std::uint32_t a) const -> std::uint32_t {
+#ifdef __SIZEOF_INT128__
+    // The fractional part of a / divisor() times divisor()
+    const std::uint64_t fraction = m_multiplier * a;
+    return static_cast<std::uint32_t>((static_cast<unsigned __int128>(fraction) * m_divisor) >>
+                                      64);
+#else
+    return a % m_divisor;
+#endif
+  }
+
+  /**
+   * Finds the smallest value x >= a such that x % divisor() == 0
+   *
+   * Same as MathUtils::roundUp(a, divisor()); the result must fit into 32 bit.
+   */
+  [[nodiscard]] constexpr auto roundUp(std::uint32_t a) const -> std::uint32_t {
+    const std::uint32_t remainder = modulo(a);
+    return remainder == 0 ? a : a + (m_divisor - remainder);
   }
 };
 
@@ -9,6 +9,7 @@
 
 #include <cstddef>
 #include <string>
+#include <string_view>
 #include <sys/stat.h>
 #include <utility>
 
@@ -30,6 +31,8 @@ class Path {
 
   Path(std::string path) : m_path(std::move(path)) { init(); }
 
+  Path(std::string_view path) : m_path(path) { init(); }
+
   /**
    * @return The string representing the current path
    */
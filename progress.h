@@ -9,14 +9,28 @@
 
 #include "utils/env.h"
 #include "utils/logger.h"
+#include "utils/stringbuilder.h"
 #include "utils/stringutils.h"
+#include "utils/timeutils.h"
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
 #include <fstream>
-#include <iomanip>
+#include <initializer_list>
 #include <iostream>
+#include <mutex>
+#include <signal.h>
 #include <stdio.h>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
 #include <sys/ioctl.h>
 #include <unistd.h>
 
@@ -25,152 +39,942 @@ namespace utils {
 // TODO replace this with constexpr in C++11
 #define ROTATION_IND "-\\|/"
 
+/**
+ * Estimates the rate of a counter with an exponentially weighted moving average
+ *
+ * The weight of a new sample depends on the time since the previous sample,
+ * so irregular sampling intervals do not bias the estimate.
+ */
+class RateEstimator {
+  public:
+  using Clock = std::chrono::steady_clock;
+
+  private:
+  /** Time (in seconds) after which the weight of an old rate dropped to 1/e */
+  double m_timeConstant;
+
+  Clock::time_point m_lastTime;
+  unsigned long m_lastCount{0};
+
+  /** Items per second */
+  double m_rate{0};
+
+  bool m_started{false};
+  bool m_valid{false};
+
+  public:
+  explicit RateEstimator(double timeConstant = 5) : m_timeConstant(timeConstant) {}
+
+  /**
+   * Starts a new estimate
+   */
+  void reset(Clock::time_point time, unsigned long count) {
+    m_lastTime = time;
+    m_lastCount = count;
+    m_rate = 0;
+    m_started = true;
+    m_valid = false;
+  }
+
+  /**
+   * Adds a sample (the value of the counter at the given time)
+   *
+   * A counter that decreased starts a new estimate.
+   */
+  void sample(Clock::time_point time, unsigned long count) {
+    if (!m_started || count < m_lastCount) {
+      reset(time, count);
+      return;
+    }
+
+    const double dt = std::chrono::duration<double>(time - m_lastTime).count();
+    if (dt <= 0) {
+      return;
+    }
+
+    const double rate = (count - m_lastCount) / dt;
+    if (m_valid) {
+      m_rate += (1 - std::exp(-dt / m_timeConstant)) * (rate - m_rate);
+    } else {
+      m_rate = rate;
+      m_valid = true;
+    }
+
+    m_lastTime = time;
+    m_lastCount = count;
+  }
+
+  /**
+   * @return True if at least two samples are available
+   */
+  [[nodiscard]] auto valid() const -> bool { return m_valid; }
+
+  /**
+   * @return The estimated number of items per second
+   */
+  [[nodiscard]] auto rate() const -> double { return m_rate; }
+};
+
+/**
+ * Size of the terminal
+ *
+ * The size is cached and only queried again after the terminal was resized.
+ * For this, a handler for SIGWINCH is installed on first use; a previously
+ * installed handler is still called.
+ */
+class TerminalSize {
+  private:
+  /** Set by the signal handler */
+  static inline std::atomic<bool> resized{true};
+
+  static inline std::atomic<unsigned long> cachedColumns{0};
+
+#ifdef SIGWINCH
+  static inline struct sigaction previousAction {};
+#endif // SIGWINCH
+
+  public:
+  /**
+   * @return The number of columns or 0 if no terminal is attached
+   */
+  static auto columns() -> unsigned long {
+    static std::once_flag installed;
+    std::call_once(installed, installHandler);
+
+    if (resized.exchange(false, std::memory_order_acquire)) {
+      cachedColumns.store(query(), std::memory_order_relaxed);
+    }
+    return cachedColumns.load(std::memory_order_relaxed);
+  }
+
+  private:
+  /**
+   * Tries stderr, stdout and stdin
+   */
+  static auto query() -> unsigned long {
+    for (const int fd : {STDERR_FILENO, STDOUT_FILENO, STDIN_FILENO}) {
+#ifdef TIOCGSIZE
+      struct ttysize ts{};
+
+      // NOLINTNEXTLINE
+      if (ioctl(fd, TIOCGSIZE, &ts) == 0 && ts.ts_cols > 0) {
+        return ts.ts_cols;
+      }
+#elif defined(TIOCGWINSZ)
+      struct winsize ts{};
+
+      // NOLINTNEXTLINE
+      if (ioctl(fd, TIOCGWINSZ, &ts) == 0 && ts.ws_col > 0) {
+        return ts.ws_col;
+      }
+#else
+      static_cast<void>(fd);
+#endif
+    }
+    return 0;
+  }
+
+  static void installHandler() {
+#ifdef SIGWINCH
+    struct sigaction action {};
+    action.sa_sigaction = handleResize;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigaction(SIGWINCH, &action, &previousAction);
+#endif // SIGWINCH
+  }
+
+#ifdef SIGWINCH
+  static void handleResize(int signal, siginfo_t* info, void* context) {
+    resized.store(true, std::memory_order_release);
+
+    if ((previousAction.sa_flags & SA_SIGINFO) != 0) {
+      if (previousAction.sa_sigaction != nullptr) {
+        previousAction.sa_sigaction(signal, info, context);
+      }
+    } else if (previousAction.sa_handler != SIG_DFL && previousAction.sa_handler != SIG_IGN) {
+      previousAction.sa_handler(signal);
+    }
+  }
+#endif // SIGWINCH
+};
+
+/**
+ * The stream used for progress output
+ *
+ * Selected with the environment variables UTILS_PROGRESS_OUTPUT (STDERR,
+ * STDOUT, TTY, FILE or DISABLED) and UTILS_PROGRESS_FILE.
+ */
+class ProgressOutput {
+  private:
+  std::ostream* m_stream{nullptr};
+
+  /** TTY or file handle (if used) */
+  std::ofstream m_file;
+
+  bool m_terminal{false};
+
+  public:
+  explicit ProgressOutput(const Env& env) {
+    const std::string envOutput = env.get<std::string>("OUTPUT", "STDERR");
+
+    if (StringUtils::equalsIgnoreCase(envOutput, "STDOUT")) {
+      m_stream = &std::cout;
+      m_terminal = isatty(fileno(stdout)) != 0;
+    } else if (StringUtils::equalsIgnoreCase(envOutput, "STDERR")) {
+      m_stream = &std::cerr;
+      m_terminal = isatty(fileno(stderr)) != 0;
+    } else if (StringUtils::equalsIgnoreCase(envOutput, "TTY")) {
+      m_file.open("/dev/tty"); // try unix
+      if (!m_file) {
+        m_file.open("CON:"); // try windows
+      }
+
+      if (m_file) {
+        m_stream = &m_file;
+        m_terminal = true;
+      } else {
+        logWarning() << "Could not open terminal. Disabling progress bar.";
+      }
+    } else if (StringUtils::equalsIgnoreCase(envOutput, "FILE")) {
+      const std::string filename = env.get<std::string>("FILE", "progress.log");
+      m_file.open(filename, std::ios::app);
+      if (m_file) {
+        m_stream = &m_file;
+      } else {
+        logWarning() << "Could not open" << filename << "Disabling progress output.";
+      }
+    }
+  }
+
+  ProgressOutput(const ProgressOutput&) = delete;
+  auto operator=(const ProgressOutput&) -> ProgressOutput& = delete;
+
+  [[nodiscard]] auto enabled() const -> bool { return m_stream != nullptr; }
+
+  /**
+   * @return True if the output is a terminal
+   */
+  [[nodiscard]] auto terminal() const -> bool { return m_terminal; }
+
+  [[nodiscard]] auto stream() const -> std::ostream& { return *m_stream; }
+
+  /**
+   * Writes data with a single write and flushes the stream
+   */
+  void write(std::string_view data) {
+    m_stream->write(data.data(), static_cast<std::streamsize>(data.size()));
+    m_stream->flush();
+  }
+};
+
 class Progress {
+  public:
+  /** Additional information shown after the progress bar */
+  enum Field { ELAPSED = 1, RATE = 2, ETA = 4 };
+
   private:
   enum OutputType {
     DISABLED,
-    TTY
-    // TODO Support file output
+    /** Progress bar that is redrawn in the same line */
+    TTY,
+    /** One line per record, e.g. for log files */
+    LINE,
+    /** One JSON object per line */
+    JSON
   };
 
+  Env env{"UTILS_PROGRESS_"};
+
   /** The output stream we use */
-  std::ostream* m_output;
+  ProgressOutput m_output{env};
 
-  OutputType m_type;
+  OutputType m_type{DISABLED};
 
   /** Total number of updates */
-  unsigned long m_total{};
+  std::atomic<unsigned long> m_total;
 
-  /** Current update status */
-  unsigned long m_current{0};
+  /** Current update status (can be larger than m_total in concurrent mode) */
+  std::atomic<unsigned long> m_current{0};
 
   /** Size of the progress bar */
   unsigned long m_barSize{80};
 
+  /** True if the size follows the terminal size */
+  bool m_autoSize{false};
+
   /** Rotation indicator position */
   unsigned char m_rotPosition{0};
 
-  /** TTY handle (if used) */
-  std::ofstream m_tty;
+  /** Minimum time between two moves of the rotation indicator */
+  static constexpr std::chrono::milliseconds SpinnerInterval{100};
 
-  Env env{"UTILS_PROGRESS_"};
+  /** The line of the progress bar (allocated once) */
+  StringBuilder m_line;
 
-  public:
-  Progress(unsigned long total = 100) {
-    std::string envOutput = env.get<std::string>("OUTPUT", "STDERR");
+  /** Visible state of the last drawn progress bar */
+  int m_lastPercent{-1};
+  unsigned long m_lastComChars{0};
+  std::chrono::steady_clock::time_point m_lastSpin;
 
-    StringUtils::toUpper(envOutput);
+  /** Combination of Field values */
+  unsigned int m_fields{0};
 
-    if (envOutput == "STDOUT") {
-      m_output = &std::cout;
-      m_type = TTY;
+  RateEstimator::Clock::time_point m_startTime{RateEstimator::Clock::now()};
 
-      setSize(isatty(fileno(stdout)) != 0);
-    } else if (envOutput == "STDERR") {
-      m_output = &std::cerr;
-      m_type = TTY;
+  /** Only updated when the progress bar is drawn */
+  RateEstimator m_rate;
 
-      setSize(isatty(fileno(stderr)) != 0);
-    } else if (envOutput == "TTY") {
-      m_tty.open("/dev/tty"); // try unix
-      if (!m_tty) {
-        m_tty.open("CON:"); // try windows
-      }
+  /** Minimum time in seconds between two records (LINE and JSON only) */
+  double m_interval{10};
+
+  /** A record is written whenever a multiple of m_step percent is reached (0 to disable) */
+  double m_step{10};
+
+  RateEstimator::Clock::time_point m_lastRecordTime{m_startTime};
+  long m_lastRecordStep{-1};
+  unsigned long m_lastRecordCount{0};
+  bool m_hasRecord{false};
+
+  /** True if the final state was drawn by update() (further updates are skipped) */
+  bool m_finalDrawn{false};
+
+  /** True if the progress of all MPI ranks is shown */
+  bool m_distributed{false};
+
+  /** Result of the last completed reduction (distributed mode only) */
+  bool m_hasGlobal{false};
+  unsigned long m_globalCount{0};
+  unsigned long m_globalTotal{0};
+  double m_minFraction{0};
+  double m_maxFraction{0};
+
+#ifdef MPI_VERSION
+  /** Duplicate of the communicator, so reductions do not interfere with the application */
+  MPI_Comm m_comm{MPI_COMM_NULL};
+  int m_commSize{1};
 
-      if (m_tty) {
-        m_output = &m_tty;
+  /** Minimum time between two tests for completed reductions */
+  static constexpr std::chrono::milliseconds PollInterval{10};
+  std::chrono::steady_clock::time_point m_lastPoll;
+
+  /** The two non-blocking reductions of the current round */
+  MPI_Request m_requests[2]{MPI_REQUEST_NULL, MPI_REQUEST_NULL};
+  bool m_pending{false};
+
+  /** Sum of (count, total, finished ranks) */
+  unsigned long m_sendSum[3]{};
+  unsigned long m_recvSum[3]{};
+
+  /** Maximum of (fraction, -fraction) */
+  double m_sendMax[2]{};
+  double m_recvMax[2]{};
+#endif // MPI_VERSION
+
+  /** True if the progress bar is updated by several threads */
+  bool m_concurrent{false};
+
+  /** Redraws the progress bar in concurrent mode */
+  std::thread m_renderer;
+  std::mutex m_rendererMutex;
+  std::condition_variable m_rendererWakeup;
+  bool m_stopRenderer{false};
+
+  public:
+  /**
+   * The output is configured with environment variables:
+   * - UTILS_PROGRESS_OUTPUT: STDERR (default), STDOUT, TTY, FILE or DISABLED
+   * - UTILS_PROGRESS_FILE: The file used for FILE output (appended)
+   * - UTILS_PROGRESS_FORMAT: BAR, LINE, JSON or AUTO (default: BAR for
+   *   terminals and LINE otherwise)
+   * - UTILS_PROGRESS_INTERVAL, UTILS_PROGRESS_STEP: See setInterval()
+   */
+  Progress(unsigned long total = 100) : m_total(total) {
+    if (m_output.enabled()) {
+      const bool terminal = m_output.terminal();
+      const std::string format = env.get<std::string>("FORMAT", "AUTO");
+      if (StringUtils::equalsIgnoreCase(format, "BAR")) {
         m_type = TTY;
-        setSize();
+      } else if (StringUtils::equalsIgnoreCase(format, "LINE")) {
+        m_type = LINE;
+      } else if (StringUtils::equalsIgnoreCase(format, "JSON")) {
+        m_type = JSON;
       } else {
-        logWarning() << "Could not open terminal. Disabling progress bar.";
-        m_type = DISABLED;
+        if (!StringUtils::equalsIgnoreCase(format, "AUTO")) {
+          logWarning() << "Unknown progress format" << format;
+        }
+        // Carriage returns only make sense on terminals
+        m_type = terminal ? TTY : LINE;
       }
-    } else {
+
+      if (m_type == TTY) {
+        setSize(terminal);
+        m_line.reserve(m_barSize + 1);
+      }
+    }
+
+    setInterval(env.get<double>("INTERVAL", 10.0), env.get<double>("STEP", 10.0));
+
+    // e.g. UTILS_PROGRESS_FIELDS=elapsed,rate,eta
+    for (const auto& field : StringUtils::split(env.get<std::string>("FIELDS", ""), ',')) {
+      const std::string_view name = StringUtils::trimView(field);
+      if (StringUtils::equalsIgnoreCase(name, "elapsed")) {
+        m_fields |= ELAPSED;
+      } else if (StringUtils::equalsIgnoreCase(name, "rate")) {
+        m_fields |= RATE;
+      } else if (StringUtils::equalsIgnoreCase(name, "eta")) {
+        m_fields |= ETA;
+      } else if (!name.empty()) {
+        logWarning() << "Unknown progress field" << std::string(name);
+      }
+    }
+
+    m_rate.reset(m_startTime, 0);
+  }
+
+  ~Progress() {
+    if (m_concurrent || m_distributed) {
+      stop();
+    }
+  }
+
+#ifdef MPI_VERSION
+  /**
+   * Shows the progress of all ranks in comm (collective)
+   *
+   * Each rank sets its own counter and total. The values of all ranks are
+   * combined with non-blocking reductions which are tested in update()
+   * (or by the renderer in concurrent mode); no blocking collective is
+   * called until stop(). The display rank shows the global progress and
+   * the smallest and largest progress of a single rank. The shown values can
+   * be behind by a few updates.
+   *
+   * stop() (or the destructor) must be called by all ranks before
+   * MPI_Finalize. In concurrent mode, the renderer thread calls MPI, which
+   * requires MPI_THREAD_MULTIPLE if other threads use MPI at the same time.
+   * Calling this again is only allowed after stop().
+   */
+  void setDistributed(MPI_Comm comm, int displayRank = 0) {
+    if (m_comm != MPI_COMM_NULL) {
+      logError() << "Distributed mode is already active; call stop() before setDistributed()";
+      return;
+    }
+
+    int rank = 0;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &m_commSize);
+    MPI_Comm_dup(comm, &m_comm);
+    m_distributed = true;
+
+    if (rank != displayRank) {
       m_type = DISABLED;
     }
   }
+#endif // MPI_VERSION
+
+  /**
+   * Switches to concurrent mode
+   *
+   * A background thread redraws the progress bar with the given interval.
+   * Afterwards set(), add(), update() and increment() only change an atomic
+   * counter and can be called from several threads (e.g. in an OpenMP loop).
+   * Must not be called while other threads update the progress bar.
+   */
+  void start(std::chrono::milliseconds interval = std::chrono::milliseconds(100)) {
+    if (m_concurrent) {
+      return;
+    }
+    m_concurrent = true;
+
+    if (m_type == DISABLED && !m_distributed) {
+      return;
+    }
+
+    m_stopRenderer = false;
+    m_renderer = std::thread([this, interval]() {
+      std::unique_lock<std::mutex> lock(m_rendererMutex);
+      while (!m_rendererWakeup.wait_for(lock, interval, [this]() { return m_stopRenderer; })) {
+        pollDistributed();
+        if (m_type != DISABLED) {
+          draw(false);
+        }
+      }
+    });
+  }
+
+  /**
+   * Stops the concurrent and the distributed mode and prints the final state
+   * followed by a newline
+   *
+   * Must not be called while other threads update the progress bar. In
+   * distributed mode, this waits until all ranks called stop().
+   */
+  void stop() {
+    if (!m_concurrent && !m_distributed) {
+      return;
+    }
+    stopRenderer();
+    finishDistributed();
+
+    if (m_type != DISABLED) {
+      draw(true);
+      if (m_type == TTY) {
+        m_output.write("\n");
+      }
+    }
+
+    m_distributed = false;
+    m_hasGlobal = false;
+  }
+
+  /**
+   * Configures when records are written (only for LINE and JSON output)
+   *
+   * A record is written if the time since the last record is at least
+   * seconds or if the next multiple of step percent is reached. The final
+   * state is always written.
+   *
+   * Can also be called in concurrent mode.
+   *
+   * @param seconds Use 0 to write a record on every update
+   * @param step Use 0 to only write records based on the time
+   */
+  void setInterval(double seconds, double step = 0) {
+    // The renderer draws while holding the mutex
+    const std::lock_guard<std::mutex> lock(m_rendererMutex);
+    m_interval = seconds;
+    m_step = step;
+  }
+
+  /**
+   * Selects the information shown after the progress bar
+   *
+   * Can also be set with UTILS_PROGRESS_FIELDS (e.g. "elapsed,rate,eta") and
+   * changed in concurrent mode.
+   *
+   * @param fields A combination of Field values
+   */
+  void setFields(unsigned int fields) {
+    const std::lock_guard<std::mutex> lock(m_rendererMutex);
+    m_fields = fields;
+  }
 
   /**
    * Set a new total value
    * Does not update the progress bar
    */
-  void setTotal(unsigned long total) { m_total = total; }
+  void setTotal(unsigned long total) { m_total.store(total, std::memory_order_relaxed); }
 
   /**
    * Set the current value of the progress bar without updating the screen
    */
-  void set(unsigned long current) { m_current = std::min(current, m_total); }
+  void set(unsigned long current) {
+    m_current.store(std::min(current, m_total.load(std::memory_order_relaxed)),
+                    std::memory_order_relaxed);
+  }
+
+  /**
+   * Increments the current value without updating the screen
+   */
+  void add(unsigned long count) { m_current.fetch_add(count, std::memory_order_relaxed); }
 
   /**
    * Update the progress bar
    *
-   * If <code>current >= total</code> a newline is printed and it is no longer
-   * possible to update screen
+   * In concurrent mode, only the current value is set.
    */
   void update(unsigned long current) {
     set(current);
 
+    if (m_concurrent) {
+      return;
+    }
+
+    pollDistributed();
     if (m_type == DISABLED) {
       return;
     }
 
-    // Calculuate the ratio of complete-to-incomplete.
-    const float ratio = m_current / static_cast<float>(m_total);
+    // In distributed mode, only stop() knows that all ranks are finished
+    const bool finished =
+        !m_distributed &&
+        m_current.load(std::memory_order_relaxed) >= m_total.load(std::memory_order_relaxed);
+    if (finished && m_finalDrawn) {
+      return;
+    }
+    m_finalDrawn = finished;
+    draw(finished);
+  }
 
-    // Show the percentage complete
-    (*m_output) << std::setw(3) << (int)(ratio * 100) << "% [";
+  /**
+   * Updates the progress bar but does not change the current value
+   */
+  void update() { update(m_current.load(std::memory_order_relaxed)); }
 
-    // real width (without additional chars)
-    const unsigned long realSize = m_barSize - 9;
+  /**
+   * Updates the progress bar and increments it by one
+   *
+   * In concurrent mode, this is a single atomic addition.
+   */
+  void increment() {
+    if (m_concurrent) {
+      add(1);
+      return;
+    }
 
-    const unsigned long comChars = realSize * ratio;
+    update(m_current.load(std::memory_order_relaxed) + 1);
+  }
 
-    // Show the load bar
-    for (unsigned int i = 0; i < comChars; i++) {
-      (*m_output) << '=';
+  /**
+   * Removes the progress bar from the output
+   *
+   * Stops the concurrent mode without printing the final state.
+   */
+  void clear() {
+    if (m_concurrent) {
+      stopRenderer();
+    }
+
+    if (m_type != TTY) {
+      return;
+    }
+
+    m_line.clear();
+    m_line.append(' ', m_barSize).append('\r');
+    m_output.write(m_line.view());
+
+    // Draw the bar again on the next update
+    m_lastPercent = -1;
+    m_finalDrawn = false;
+  }
+
+  private:
+  /**
+   * @return The counter and the total that are shown (the global values in
+   *  distributed mode)
+   */
+  [[nodiscard]] auto shownState() const -> std::pair<unsigned long, unsigned long> {
+    if (m_hasGlobal) {
+      return {m_globalCount, m_globalTotal};
+    }
+    return {m_current.load(std::memory_order_relaxed), m_total.load(std::memory_order_relaxed)};
+  }
+
+  /**
+   * Tests if the current reduction is completed and starts the next one
+   */
+  void pollDistributed() {
+#ifdef MPI_VERSION
+    if (!m_distributed) {
+      return;
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    if (now - m_lastPoll < PollInterval) {
+      return;
+    }
+    m_lastPoll = now;
+
+    if (m_pending) {
+      int completed = 0;
+      MPI_Testall(2, m_requests, &completed, MPI_STATUSES_IGNORE);
+      if (completed == 0) {
+        return;
+      }
+      finishRound();
+    }
+    startRound(false);
+#endif // MPI_VERSION
+  }
+
+  /**
+   * Completes the reductions of all ranks
+   *
+   * Ranks that are finished keep starting reductions until all ranks are
+   * finished. Since every round has the same result on all ranks, all ranks
+   * leave after the same round.
+   */
+  void finishDistributed() {
+#ifdef MPI_VERSION
+    if (m_comm == MPI_COMM_NULL) {
+      return;
+    }
+
+    while (true) {
+      if (!m_pending) {
+        startRound(true);
+      }
+      MPI_Waitall(2, m_requests, MPI_STATUSES_IGNORE);
+      finishRound();
+      if (m_recvSum[2] == static_cast<unsigned long>(m_commSize)) {
+        break;
+      }
+
+      // Show the progress of the remaining ranks
+      if (m_type != DISABLED) {
+        draw(false);
+      }
+    }
+
+    MPI_Comm_free(&m_comm);
+#endif // MPI_VERSION
+  }
+
+#ifdef MPI_VERSION
+  void startRound(bool finished) {
+    const unsigned long total = m_total.load(std::memory_order_relaxed);
+    const unsigned long current = std::min(m_current.load(std::memory_order_relaxed), total);
+    const double fraction = total == 0 ? 1 : static_cast<double>(current) / total;
+
+    m_sendSum[0] = current;
+    m_sendSum[1] = total;
+    m_sendSum[2] = finished ? 1 : 0;
+    m_sendMax[0] = fraction;
+    m_sendMax[1] = -fraction;
+
+    MPI_Iallreduce(m_sendSum, m_recvSum, 3, MPI_UNSIGNED_LONG, MPI_SUM, m_comm, &m_requests[0]);
+    MPI_Iallreduce(m_sendMax, m_recvMax, 2, MPI_DOUBLE, MPI_MAX, m_comm, &m_requests[1]);
+    m_pending = true;
+  }
+
+  void finishRound() {
+    m_pending = false;
+    m_hasGlobal = true;
+    m_globalCount = m_recvSum[0];
+    m_globalTotal = m_recvSum[1];
+    m_maxFraction = m_recvMax[0];
+    m_minFraction = -m_recvMax[1];
+  }
+#endif // MPI_VERSION
+
+  void stopRenderer() {
+    if (m_renderer.joinable()) {
+      {
+        const std::lock_guard<std::mutex> lock(m_rendererMutex);
+        m_stopRenderer = true;
+      }
+      m_rendererWakeup.notify_one();
+      m_renderer.join();
+    }
+    m_concurrent = false;
+  }
+
+  /**
+   * Writes the progress bar or a record
+   *
+   * @param final True if this is the final state (always written)
+   */
+  void draw(bool final) {
+    if (m_type == TTY) {
+      drawBar(final);
+    } else {
+      writeRecord(final);
     }
+  }
 
-    for (unsigned int i = comChars; i < realSize; i++) {
-      (*m_output) << ' ';
+  /**
+   * Writes the progress bar with a single write
+   *
+   * Nothing is written if the visible state does not change, unless force is
+   * set. The rotation indicator moves at most every SpinnerInterval.
+   */
+  void drawBar(bool force) {
+    if (m_autoSize) {
+      const unsigned long columns = TerminalSize::columns();
+      if (columns > 0 && columns != m_barSize) {
+        m_barSize = columns;
+        force = true;
+      }
     }
 
-    (*m_output) << "] ";
+    const auto [count, total] = shownState();
+    const unsigned long current = std::min(count, total);
+
+    // Calculuate the ratio of complete-to-incomplete.
+    const float ratio = total == 0 ? 1.0F : current / static_cast<float>(total);
+    const int percent = static_cast<int>(ratio * 100);
+
+    // real width (without additional chars)
+    const unsigned long used = 9 + fieldsWidth();
+    const unsigned long realSize = m_barSize > used ? m_barSize - used : 0;
+
+    const auto comChars = static_cast<unsigned long>(realSize * ratio);
+
+    const auto now = RateEstimator::Clock::now();
+    const bool spin = now - m_lastSpin >= SpinnerInterval;
+    if (!force && !spin && percent == m_lastPercent && comChars == m_lastComChars) {
+      return;
+    }
+    m_lastPercent = percent;
+    m_lastComChars = comChars;
+    if (spin) {
+      m_lastSpin = now;
+      m_rotPosition = (m_rotPosition + 1) % 4;
+    }
+
+    m_line.clear();
+
+    // Show the percentage complete
+    m_line.append(' ', percent < 10 ? 2 : (percent < 100 ? 1 : 0)).appendNumber(percent);
+    m_line.append("% [");
+
+    // Show the load bar
+    m_line.append('=', comChars).append(' ', realSize - comChars).append("] ");
 
     // Print rotation indicator
-    (*m_output) << ROTATION_IND[m_rotPosition];
-    m_rotPosition = (m_rotPosition + 1) % 4;
+    m_line.append(ROTATION_IND[m_rotPosition]);
+
+    if (m_fields != 0 || m_distributed) {
+      m_rate.sample(now, count);
+      appendFields(m_line, now, current, total);
+    }
 
     // go to the beginning of the line
-    (*m_output) << '\r' << std::flush;
+    m_line.append('\r');
+
+    m_output.write(m_line.view());
   }
 
   /**
-   * Updates the progress bar but does not change the current value
+   * Writes a LINE or JSON record if the interval or the step is reached
    */
-  void update() { update(m_current); }
+  void writeRecord(bool final) {
+    const auto [count, total] = shownState();
+    const unsigned long current = std::min(count, total);
+    const double percent = total == 0 ? 100 : 100.0 * current / total;
+    const auto now = RateEstimator::Clock::now();
+
+    const long step = m_step > 0 ? static_cast<long>(percent / m_step) : -1;
+    const bool due = std::chrono::duration<double>(now - m_lastRecordTime).count() >= m_interval ||
+                     step > m_lastRecordStep;
+    if (!due && !(final && (!m_hasRecord || m_lastRecordCount != count))) {
+      return;
+    }
+    m_lastRecordTime = now;
+    m_lastRecordStep = step;
+    m_lastRecordCount = count;
+    m_hasRecord = true;
+
+    m_rate.sample(now, count);
+    const double elapsed = std::chrono::duration<double>(now - m_startTime).count();
+    double remaining = -1;
+    if (current >= total) {
+      remaining = 0;
+    } else if (m_rate.valid() && m_rate.rate() > 0) {
+      remaining = (total - current) / m_rate.rate();
+    }
+
+    StringBuilder record;
+    record.reserve(128);
+    if (m_type == JSON) {
+      record.append("{\"percent\":").appendNumber(percent, std::chars_format::fixed, 1);
+      record.append(",\"count\":").appendNumber(current);
+      record.append(",\"total\":").appendNumber(total);
+      record.append(",\"elapsed\":").appendNumber(elapsed, std::chars_format::fixed, 3);
+      record.append(",\"rate\":");
+      if (m_rate.valid()) {
+        record.appendNumber(m_rate.rate(), std::chars_format::general, 6);
+      } else {
+        record.append("null");
+      }
+      record.append(",\"eta\":");
+      if (remaining >= 0) {
+        record.appendNumber(remaining, std::chars_format::fixed, 3);
+      } else {
+        record.append("null");
+      }
+      if (m_distributed) {
+        record.append(",\"min\":").appendNumber(m_minFraction * 100, std::chars_format::fixed, 1);
+        record.append(",\"max\":").appendNumber(m_maxFraction * 100, std::chars_format::fixed, 1);
+      }
+      record.append("}\n");
+    } else {
+      record.appendNumber(percent, std::chars_format::fixed, 1).append("% ");
+      record.appendNumber(current).append('/').appendNumber(total);
+      record.append(" elapsed ").append(TimeUtils::durationAsString(elapsed));
+      if (m_rate.valid()) {
+        record.append(" rate ").appendNumber(m_rate.rate(), std::chars_format::fixed, 1);
+        record.append("/s");
+      }
+      record.append(" eta ").append(TimeUtils::durationAsString(remaining));
+      if (m_distributed) {
+        record.append(" min ").appendNumber(m_minFraction * 100, std::chars_format::fixed, 1);
+        record.append("% max ").appendNumber(m_maxFraction * 100, std::chars_format::fixed, 1);
+        record.append('%');
+      }
+      record.append('\n');
+    }
+
+    // One write per record keeps the output easy to follow with tail -f
+    m_output.write(record.view());
+  }
 
   /**
-   * Updates the progress bar and increments it by one
+   * @return The number of characters used by the selected fields
    */
-  void increment() { update(m_current + 1); }
+  [[nodiscard]] auto fieldsWidth() const -> unsigned long {
+    return ((m_fields & ELAPSED) != 0 ? 9 : 0) + ((m_fields & RATE) != 0 ? 9 : 0) +
+           ((m_fields & ETA) != 0 ? 13 : 0) + (m_distributed ? 18 : 0);
+  }
 
   /**
-   * Removes the progress bar from the output
+   * Appends the selected fields (with a fixed width)
    */
-  void clear() {
-    if (m_type == DISABLED) {
-      return;
+  void appendFields(StringBuilder& fields,
+                    RateEstimator::Clock::time_point now,
+                    unsigned long current,
+                    unsigned long total) {
+    if ((m_fields & ELAPSED) != 0) {
+      const double elapsed = std::chrono::duration<double>(now - m_startTime).count();
+      fields.append(' ').appendPadLeft(TimeUtils::durationAsString(elapsed), 8, ' ');
+    }
+    if ((m_fields & RATE) != 0) {
+      fields.append(' ');
+      if (m_rate.valid()) {
+        appendRate(fields, m_rate.rate());
+      } else {
+        fields.append("     -/s");
+      }
+    }
+    if ((m_fields & ETA) != 0) {
+      double remaining = -1;
+      if (current >= total) {
+        remaining = 0;
+      } else if (m_rate.valid() && m_rate.rate() > 0) {
+        remaining = (total - current) / m_rate.rate();
+      }
+      fields.append(" ETA ").appendPadLeft(TimeUtils::durationAsString(remaining), 8, ' ');
+    }
+    if (m_distributed) {
+      // Progress of the slowest and the fastest rank
+      StringBuilder percent;
+      percent.appendNumber(static_cast<int>(m_minFraction * 100));
+      fields.append(" min ").appendPadLeft(percent.view(), 3, ' ').append('%');
+      percent.clear();
+      percent.appendNumber(static_cast<int>(m_maxFraction * 100));
+      fields.append(" max ").appendPadLeft(percent.view(), 3, ' ').append('%');
     }
+  }
 
-    for (unsigned int i = 0; i < m_barSize; i++) {
-      (*m_output) << ' ';
+  /**
+   * Appends a rate with 8 characters (e.g. " 12.3k/s")
+   */
+  static void appendRate(StringBuilder& out, double rate) {
+    const char* prefix = " kMGTPE";
+    while (rate >= 999.95 && prefix[1] != '\0') {
+      rate /= 1000;
+      prefix++;
     }
-    (*m_output) << '\r' << std::flush;
+
+    StringBuilder number;
+    number.appendNumber(rate, std::chars_format::fixed, 1);
+    out.appendPadLeft(number.view(), 5, ' ').append(*prefix).append("/s");
   }
 
-  private:
   /**
    * Sets progress bar size according to the terminal size
+   *
+   * The size is updated when the terminal is resized.
    */
   void setSize(bool automatic = true) {
     // Check if size is set in env
@@ -186,22 +990,390 @@ class Progress {
       return;
     }
 
-    // Try to get terminal size
-#ifdef TIOCGSIZE
-    struct ttysize ts{};
+    const unsigned long columns = TerminalSize::columns();
+    if (columns > 0) {
+      m_barSize = columns;
+    } else {
+      logWarning() << "Could not get terminal size, using default";
+    }
+    m_autoSize = true;
+  }
+};
 
-    // NOLINTNEXTLINE
-    ioctl(STDIN_FILENO, TIOCGSIZE, &ts);
-    m_barSize = ts.ts_cols;
-#elif defined(TIOCGWINSZ)
-    struct winsize ts{};
+/**
+ * Several stacked progress bars for nested tasks
+ *
+ * Each task has its own counter and total and can have a parent. The shown
+ * progress of a task includes all of its (not removed) children, e.g. the
+ * sub-phases of a time step roll up into the time step. Since the counters of
+ * different tasks may have different units, each child contributes its
+ * completed fraction times its weight (1 by default) to the counter and its
+ * weight to the total of the parent. The shown counter of a task is its own,
+ * only the percentage includes the children. Children are shown below their
+ * parent.
+ *
+ * On terminals, all bars are redrawn in place (with ANSI escape sequences)
+ * at most every RedrawInterval. Otherwise, all tasks are collapsed into a
+ * single line which is written every UTILS_PROGRESS_INTERVAL seconds (see
+ * Progress::setInterval()). The output is configured with the same
+ * environment variables as Progress.
+ *
+ * set(), add() and increment() can be called from several threads;
+ * the other functions must not be called concurrently with them.
+ */
+class MultiProgress {
+  public:
+  using Task = std::size_t;
 
-    // NOLINTNEXTLINE
-    ioctl(STDIN_FILENO, TIOCGWINSZ, &ts);
-    m_barSize = ts.ws_col;
-#else
-    logWarning() << "Could not get terminal size, using default";
-#endif
+  /** Parent of top-level tasks */
+  static constexpr Task NoParent = static_cast<Task>(-1);
+
+  /** Minimum time between two redraws on terminals */
+  static constexpr std::chrono::milliseconds RedrawInterval{100};
+
+  private:
+  struct TaskInfo {
+    std::string name;
+    Task parent;
+    std::atomic<unsigned long> total;
+    std::atomic<unsigned long> current{0};
+    /** Number of units of the parent that the task represents */
+    double weight;
+    std::vector<Task> children;
+    bool removed{false};
+
+    /** Counter and total of the task itself (read when drawing) */
+    unsigned long shownCurrent{0};
+    unsigned long shownTotal{0};
+    /** Completed fraction including all children (computed when drawing) */
+    double shownFraction{0};
+
+    TaskInfo(std::string taskName, Task taskParent, unsigned long taskTotal, double taskWeight)
+        : name(std::move(taskName)), parent(taskParent), total(taskTotal), weight(taskWeight) {}
+  };
+
+  Env env{"UTILS_PROGRESS_"};
+
+  ProgressOutput m_output{env};
+
+  /** True if the bars are redrawn in place */
+  bool m_bar{false};
+
+  /** Width of the terminal */
+  unsigned long m_width{80};
+  bool m_autoSize{false};
+
+  /** Minimum time in seconds between two collapsed lines */
+  double m_interval{10};
+
+  /** Protects the tasks and the output */
+  std::mutex m_mutex;
+
+  /** Never moves elements, so counters can be updated without the lock */
+  std::deque<TaskInfo> m_tasks;
+  std::vector<Task> m_roots;
+
+  /** Visible tasks with their depth, in the order in which they are shown */
+  std::vector<std::pair<Task, unsigned int>> m_shown;
+
+  /** Number of lines written by the last redraw */
+  unsigned long m_drawnLines{0};
+
+  /** Time of the last draw (read without the lock) */
+  std::atomic<std::chrono::steady_clock::rep> m_lastDraw{0};
+  bool m_stopped{false};
+
+  /** All lines of one redraw (allocated once) */
+  StringBuilder m_buffer;
+
+  public:
+  /**
+   * UTILS_PROGRESS_FORMAT=BAR or AUTO on a terminal redraws the bars in
+   * place, all other formats write collapsed lines.
+   */
+  MultiProgress() {
+    if (m_output.enabled()) {
+      const std::string format = env.get<std::string>("FORMAT", "AUTO");
+      m_bar = StringUtils::equalsIgnoreCase(format, "BAR") ||
+              (StringUtils::equalsIgnoreCase(format, "AUTO") && m_output.terminal());
+    }
+
+    if (m_bar) {
+      const auto size = env.get<unsigned long>("SIZE", 0);
+      if (size > 0) {
+        m_width = size;
+      } else if (m_output.terminal()) {
+        m_autoSize = true;
+      }
+    }
+
+    m_interval = env.get<double>("INTERVAL", 10.0);
+    m_lastDraw = std::chrono::steady_clock::now().time_since_epoch().count();
+  }
+
+  MultiProgress(const MultiProgress&) = delete;
+  auto operator=(const MultiProgress&) -> MultiProgress& = delete;
+
+  ~MultiProgress() { stop(); }
+
+  /**
+   * Adds a new task which is shown below its parent
+   *
+   * @param weight Number of units of the parent that the task represents
+   * @return The handle of the task
+   */
+  auto addTask(std::string name, unsigned long total, Task parent = NoParent, double weight = 1)
+      -> Task {
+    const std::lock_guard<std::mutex> lock(m_mutex);
+    const Task task = m_tasks.size();
+    m_tasks.emplace_back(std::move(name), parent, total, weight);
+    if (parent == NoParent) {
+      m_roots.push_back(task);
+    } else {
+      m_tasks[parent].children.push_back(task);
+    }
+    return task;
+  }
+
+  /**
+   * Hides a task and all its children
+   *
+   * Removed tasks no longer count for the progress of their parent.
+   */
+  void remove(Task task) {
+    const std::lock_guard<std::mutex> lock(m_mutex);
+    m_tasks[task].removed = true;
+  }
+
+  /**
+   * Starts a task again, e.g. a sub-phase in the next time step
+   */
+  void reset(Task task, unsigned long total) {
+    m_tasks[task].total.store(total, std::memory_order_relaxed);
+    m_tasks[task].current.store(0, std::memory_order_relaxed);
+    refresh();
+  }
+
+  void setTotal(Task task, unsigned long total) {
+    m_tasks[task].total.store(total, std::memory_order_relaxed);
+    refresh();
+  }
+
+  void set(Task task, unsigned long current) {
+    m_tasks[task].current.store(current, std::memory_order_relaxed);
+    refresh();
+  }
+
+  void add(Task task, unsigned long count) {
+    m_tasks[task].current.fetch_add(count, std::memory_order_relaxed);
+    refresh();
+  }
+
+  void increment(Task task) { add(task, 1); }
+
+  /**
+   * Sets the counter of a task to its total
+   */
+  void finish(Task task) { set(task, m_tasks[task].total.load(std::memory_order_relaxed)); }
+
+  /**
+   * Redraws the bars or writes a collapsed line immediately
+   */
+  void update() {
+    const std::lock_guard<std::mutex> lock(m_mutex);
+    draw();
+  }
+
+  /**
+   * Shows the final state (done by the destructor)
+   *
+   * Afterwards, nothing is drawn anymore.
+   */
+  void stop() {
+    const std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_stopped) {
+      return;
+    }
+    draw();
+    m_stopped = true;
+  }
+
+  private:
+  /**
+   * Draws if the interval has passed and no other thread is drawing
+   */
+  void refresh() {
+    if (!m_output.enabled()) {
+      return;
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    const auto interval =
+        m_bar ? std::chrono::duration<double>(RedrawInterval).count() : m_interval;
+    const std::chrono::steady_clock::duration sinceDraw(
+        now.time_since_epoch().count() - m_lastDraw.load(std::memory_order_relaxed));
+    if (std::chrono::duration<double>(sinceDraw).count() < interval) {
+      return;
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex, std::try_to_lock);
+    if (lock.owns_lock()) {
+      draw();
+    }
+  }
+
+  /**
+   * Requires the lock
+   */
+  void draw() {
+    if (!m_output.enabled() || m_stopped) {
+      return;
+    }
+    m_lastDraw.store(std::chrono::steady_clock::now().time_since_epoch().count(),
+                     std::memory_order_relaxed);
+
+    m_shown.clear();
+    for (const Task root : m_roots) {
+      rollUp(root, 0);
+    }
+    if (m_shown.empty() && m_drawnLines == 0) {
+      return;
+    }
+
+    m_buffer.clear();
+    if (m_bar) {
+      drawBars();
+    } else {
+      drawLine();
+    }
+    m_output.write(m_buffer.view());
+  }
+
+  /**
+   * Computes the shown values of task and adds the visible tasks to m_shown
+   */
+  void rollUp(Task task, unsigned int depth) {
+    TaskInfo& info = m_tasks[task];
+    if (info.removed) {
+      return;
+    }
+    m_shown.emplace_back(task, depth);
+
+    info.shownTotal = info.total.load(std::memory_order_relaxed);
+    info.shownCurrent = std::min(info.current.load(std::memory_order_relaxed), info.shownTotal);
+
+    // Children contribute fractions, so counters with different units can be combined
+    double current = info.shownCurrent;
+    double total = info.shownTotal;
+    for (const Task child : info.children) {
+      rollUp(child, depth + 1);
+      const TaskInfo& childInfo = m_tasks[child];
+      if (!childInfo.removed) {
+        current += childInfo.weight * childInfo.shownFraction;
+        total += childInfo.weight;
+      }
+    }
+    info.shownFraction = total > 0 ? std::min(current / total, 1.0) : 1.0;
+  }
+
+  /**
+   * Writes one line per task and moves the cursor back to the first line
+   */
+  void drawBars() {
+    if (m_autoSize) {
+      const unsigned long columns = TerminalSize::columns();
+      if (columns > 0) {
+        m_width = columns;
+      }
+    }
+
+    // Column widths
+    std::size_t nameWidth = 0;
+    std::size_t countWidth = 0;
+    for (const auto& [task, depth] : m_shown) {
+      const TaskInfo& info = m_tasks[task];
+      nameWidth = std::max(nameWidth, 2 * depth + info.name.size());
+      countWidth = std::max(countWidth, 2 * digits(info.shownTotal) + 1);
+    }
+    // Writing into the last column would wrap the line on some terminals
+    const std::size_t width = m_width > 1 ? m_width - 1 : 0;
+    nameWidth = std::min(nameWidth, width / 3);
+    const std::size_t used = nameWidth + countWidth + 9;
+    const std::size_t barSize = width > used ? width - used : 0;
+
+    // Move up to the first line
+    if (m_drawnLines > 0) {
+      m_buffer.append("\x1b[").appendNumber(m_drawnLines).append('A');
+    }
+    m_buffer.append('\r');
+
+    for (const auto& [task, depth] : m_shown) {
+      const TaskInfo& info = m_tasks[task];
+      const double ratio = info.shownFraction;
+      const int percent = static_cast<int>(ratio * 100);
+      const auto comChars = static_cast<std::size_t>(barSize * ratio);
+
+      const std::size_t indent = std::min<std::size_t>(2 * depth, nameWidth);
+      m_buffer.append(' ', indent);
+      m_buffer.appendPadRight(std::string_view(info.name).substr(0, nameWidth - indent),
+                              nameWidth - indent,
+                              ' ');
+
+      m_buffer.append(' ', percent < 10 ? 3 : (percent < 100 ? 2 : 1)).appendNumber(percent);
+      m_buffer.append("% [").append('=', comChars).append(' ', barSize - comChars).append("] ");
+
+      const std::size_t start = m_buffer.size();
+      m_buffer.appendNumber(info.shownCurrent).append('/').appendNumber(info.shownTotal);
+      m_buffer.append(' ', countWidth - (m_buffer.size() - start));
+
+      // Clear the rest of the line
+      m_buffer.append("\x1b[K\n");
+    }
+
+    // Remove lines of removed tasks
+    m_buffer.append("\x1b[J");
+    m_drawnLines = m_shown.size();
+  }
+
+  /**
+   * Writes all tasks in a single line, e.g.
+   * <code>step 3/10 31.4% | step/compute 45/100 45.0%</code>
+   */
+  void drawLine() {
+    for (std::size_t i = 0; i < m_shown.size(); i++) {
+      const TaskInfo& info = m_tasks[m_shown[i].first];
+      if (i > 0) {
+        m_buffer.append(" | ");
+      }
+      appendPath(m_shown[i].first);
+      m_buffer.append(' ').appendNumber(info.shownCurrent).append('/').appendNumber(
+          info.shownTotal);
+      m_buffer.append(' ')
+          .appendNumber(100 * info.shownFraction, std::chars_format::fixed, 1)
+          .append('%');
+    }
+    m_buffer.append('\n');
+  }
+
+  /**
+   * Appends the names of all parents and the task, separated by '/'
+   */
+  void appendPath(Task task) {
+    const TaskInfo& info = m_tasks[task];
+    if (info.parent != NoParent) {
+      appendPath(info.parent);
+      m_buffer.append('/');
+    }
+    m_buffer.append(info.name);
+  }
+
+  static auto digits(unsigned long value) -> std::size_t {
+    std::size_t count = 1;
+    while (value >= 10) {
+      value /= 10;
+      count++;
+    }
+    return count;
   }
 };
 
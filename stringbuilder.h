@@ -0,0 +1,215 @@
+// SPDX-FileCopyrightText: 2024 Technical University of Munich
+//
+// SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef UTILS_STRINGBUILDER_H_
+#define UTILS_STRINGBUILDER_H_
+
+#include <charconv>
+#include <cstddef>
+#include <cstdio>
+#include <limits>
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+namespace utils {
+
+/**
+ * Builds a string by appending pieces to a single buffer
+ *
+ * Numbers are converted with std::to_chars directly into the buffer and
+ * padding is written in bulk. Reserve the final size if it is known to avoid
+ * any reallocation.
+ *
+ * @tparam Allocator Use ArenaStringBuilder to allocate the buffer from a
+ *  caller-provided memory resource (e.g. std::pmr::monotonic_buffer_resource)
+ */
+template <typename Allocator = std::allocator<char>>
+class BasicStringBuilder {
+  public:
+  using String = std::basic_string<char, std::char_traits<char>, Allocator>;
+
+  private:
+  String m_buffer;
+
+  public:
+  BasicStringBuilder() = default;
+
+  explicit BasicStringBuilder(const Allocator& allocator) : m_buffer(allocator) {}
+
+  /**
+   * Reserves at least capacity characters
+   */
+  auto reserve(std::size_t capacity) -> BasicStringBuilder& {
+    m_buffer.reserve(capacity);
+    return *this;
+  }
+
+  auto append(char c) -> BasicStringBuilder& {
+    m_buffer.push_back(c);
+    return *this;
+  }
+
+  /**
+   * Appends the character c count times
+   */
+  auto append(char c, std::size_t count) -> BasicStringBuilder& {
+    m_buffer.append(count, c);
+    return *this;
+  }
+
+  auto append(std::string_view str) -> BasicStringBuilder& {
+    m_buffer.append(str.data(), str.size());
+    return *this;
+  }
+
+  /**
+   * Appends str, padded with padchar on the left to at least size characters
+   */
+  auto appendPadLeft(std::string_view str, std::size_t size, char padchar)
+      -> BasicStringBuilder& {
+    if (str.size() < size) {
+      append(padchar, size - str.size());
+    }
+    return append(str);
+  }
+
+  /**
+   * Appends str, padded with padchar on the right to at least size characters
+   */
+  auto appendPadRight(std::string_view str, std::size_t size, char padchar)
+      -> BasicStringBuilder& {
+    append(str);
+    if (str.size() < size) {
+      append(padchar, size - str.size());
+    }
+    return *this;
+  }
+
+  /**
+   * Appends an integer or the shortest representation of a floating point
+   * number that can be parsed again without loss
+   */
+  template <typename T>
+  auto appendNumber(T value) -> BasicStringBuilder& {
+    static_assert(std::is_arithmetic_v<T> && !std::is_same_v<T, bool>,
+                  "Only integer and floating point numbers are supported");
+    return appendChars([value](char* first, char* last) { return toChars(first, last, value); });
+  }
+
+  /**
+   * Appends a floating point number in the given format
+   *
+   * Use <code>std::chars_format::general</code> with precision 6 to get the
+   * same output as <code>std::ostream::operator<<</code>.
+   */
+  template <typename T>
+  auto appendNumber(T value, std::chars_format format, int precision) -> BasicStringBuilder& {
+    static_assert(std::is_floating_point_v<T>, "Only floating point numbers are supported");
+    return appendChars([value, format, precision](char* first, char* last) {
+      return toChars(first, last, value, format, precision);
+    });
+  }
+
+  [[nodiscard]] auto size() const -> std::size_t { return m_buffer.size(); }
+
+  [[nodiscard]] auto empty() const -> bool { return m_buffer.empty(); }
+
+  void clear() { m_buffer.clear(); }
+
+  /**
+   * @return A view on the current content (invalidated by the next append)
+   */
+  [[nodiscard]] auto view() const -> std::string_view { return m_buffer; }
+
+  [[nodiscard]] auto str() const& -> String { return m_buffer; }
+
+  /**
+   * Moves the content out of the builder without copying it
+   */
+  [[nodiscard]] auto str() && -> String { return std::move(m_buffer); }
+
+  private:
+  template <typename T>
+  static auto toChars(char* first, char* last, T value) -> std::to_chars_result {
+#ifdef __cpp_lib_to_chars
+    return std::to_chars(first, last, value);
+#else  // __cpp_lib_to_chars
+    if constexpr (std::is_floating_point_v<T>) {
+      // Not the shortest representation, but it can also be parsed again without loss
+      return toChars(
+          first, last, value, std::chars_format::general, std::numeric_limits<T>::max_digits10);
+    } else {
+      return std::to_chars(first, last, value);
+    }
+#endif // __cpp_lib_to_chars
+  }
+
+  template <typename T>
+  static auto toChars(char* first, char* last, T value, std::chars_format format, int precision)
+      -> std::to_chars_result {
+#ifdef __cpp_lib_to_chars
+    return std::to_chars(first, last, value, format, precision);
+#else  // __cpp_lib_to_chars
+    // Older standard libraries do not support std::to_chars for floating point numbers
+    char spec[] = "%.*Lg";
+    switch (format) {
+    case std::chars_format::scientific:
+      spec[4] = 'e';
+      break;
+    case std::chars_format::fixed:
+      spec[4] = 'f';
+      break;
+    case std::chars_format::hex:
+      spec[4] = 'a';
+      break;
+    default:
+      break;
+    }
+
+    const auto size = static_cast<std::size_t>(last - first);
+    const int length = std::snprintf(first, size, spec, precision, static_cast<long double>(value));
+    if (length < 0 || static_cast<std::size_t>(length) >= size) {
+      // snprintf also needs space for the terminating null character
+      return {last, std::errc::value_too_large};
+    }
+    return {first + length, std::errc()};
+#endif // __cpp_lib_to_chars
+  }
+
+  /**
+   * Writes to the end of the buffer with a std::to_chars like function
+   */
+  template <typename F>
+  auto appendChars(F toChars) -> BasicStringBuilder& {
+    const std::size_t oldSize = m_buffer.size();
+    std::size_t space = 32;
+    while (true) {
+      m_buffer.resize(oldSize + space);
+      char* first = m_buffer.data() + oldSize;
+      const auto [last, error] = toChars(first, first + space);
+      if (error == std::errc()) {
+        m_buffer.resize(last - m_buffer.data());
+        return *this;
+      }
+      // Only possible for very large numbers in fixed format
+      space *= 8;
+    }
+  }
+};
+
+using StringBuilder = BasicStringBuilder<>;
+
+/**
+ * A string builder which allocates from a caller-provided memory resource
+ */
+using ArenaStringBuilder = BasicStringBuilder<std::pmr::polymorphic_allocator<char>>;
+
+} // namespace utils
+
+#endif // UTILS_STRINGBUILDER_H_
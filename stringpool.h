@@ -0,0 +1,191 @@
+// SPDX-FileCopyrightText: 2024 Technical University of Munich
+//
+// SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef UTILS_STRINGPOOL_H_
+#define UTILS_STRINGPOOL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory_resource>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace utils {
+
+class StringPool;
+
+/**
+ * Handle to a string stored in a StringPool
+ *
+ * Interned strings from the same pool are equal if and only if their ids are
+ * equal. The referenced characters live as long as the pool.
+ */
+class InternedString {
+  private:
+  std::uint32_t m_id{0};
+  std::string_view m_str{""};
+
+  InternedString(std::uint32_t id, std::string_view str) : m_id(id), m_str(str) {}
+
+  friend class StringPool;
+
+  public:
+  /**
+   * Creates the interned empty string
+   */
+  InternedString() = default;
+
+  [[nodiscard]] auto id() const -> std::uint32_t { return m_id; }
+
+  [[nodiscard]] auto view() const -> std::string_view { return m_str; }
+
+  [[nodiscard]] auto str() const -> std::string { return std::string(m_str); }
+
+  /**
+   * @return A null terminated string
+   */
+  [[nodiscard]] auto c_str() const -> const char* { return m_str.data(); }
+
+  auto operator==(const InternedString& other) const -> bool { return m_id == other.m_id; }
+
+  auto operator!=(const InternedString& other) const -> bool { return m_id != other.m_id; }
+
+  /**
+   * Orders by id, i.e. by the time of interning, not lexicographically
+   */
+  auto operator<(const InternedString& other) const -> bool { return m_id < other.m_id; }
+};
+
+/**
+ * Thread-safe pool that maps strings to stable, small ids
+ *
+ * The characters are stored in an arena and never move or get freed before
+ * the pool is destroyed. Lookups with a std::string_view or a null terminated
+ * string do not allocate memory.
+ */
+class StringPool {
+  private:
+  mutable std::shared_mutex m_mutex;
+
+  /** Storage for the characters */
+  std::pmr::monotonic_buffer_resource m_arena;
+
+  /** Maps each string (stored in the arena) to its id */
+  std::unordered_map<std::string_view, std::uint32_t> m_ids;
+
+  /** All strings, indexed by their id */
+  std::vector<std::string_view> m_strings;
+
+  public:
+  StringPool() { insert(""); }
+
+  StringPool(const StringPool&) = delete;
+  auto operator=(const StringPool&) -> StringPool& = delete;
+
+  /**
+   * @return The pool used by Env, Args and other utilities
+   */
+  static auto global() -> StringPool& {
+    static StringPool pool;
+    return pool;
+  }
+
+  /**
+   * @return The handle for str; str is added to the pool if necessary
+   */
+  auto intern(std::string_view str) -> InternedString {
+    {
+      const std::shared_lock lock(m_mutex);
+      const auto it = m_ids.find(str);
+      if (it != m_ids.end()) {
+        return {it->second, it->first};
+      }
+    }
+
+    const std::unique_lock lock(m_mutex);
+    const auto it = m_ids.find(str);
+    if (it != m_ids.end()) {
+      return {it->second, it->first};
+    }
+    return insert(str);
+  }
+
+  /**
+   * @return The handle for str if it was interned before
+   */
+  [[nodiscard]] auto find(std::string_view str) const -> std::optional<InternedString> {
+    const std::shared_lock lock(m_mutex);
+    const auto it = m_ids.find(str);
+    if (it == m_ids.end()) {
+      return {};
+    }
+    return InternedString(it->second, it->first);
+  }
+
+  /**
+   * @return The handle for an id returned by InternedString::id()
+   */
+  [[nodiscard]] auto get(std::uint32_t id) const -> InternedString {
+    const std::shared_lock lock(m_mutex);
+    return {id, m_strings.at(id)};
+  }
+
+  /**
+   * @return The number of strings in the pool
+   */
+  [[nodiscard]] auto size() const -> std::size_t {
+    const std::shared_lock lock(m_mutex);
+    return m_strings.size();
+  }
+
+  private:
+  /**
+   * Adds a new string (requires an exclusive lock)
+   */
+  auto insert(std::string_view str) -> InternedString {
+    // Keep a null terminator for InternedString::c_str()
+    char* data = static_cast<char*>(m_arena.allocate(str.size() + 1, 1));
+    if (!str.empty()) {
+      std::memcpy(data, str.data(), str.size());
+    }
+    data[str.size()] = '\0';
+
+    const std::string_view stored(data, str.size());
+    const auto id = static_cast<std::uint32_t>(m_strings.size());
+    m_strings.push_back(stored);
+    m_ids.emplace(stored, id);
+    return {id, stored};
+  }
+};
+
+/**
+ * Interns str in the global pool
+ *
+ * @relates utils::StringPool
+ */
+inline auto intern(std::string_view str) -> InternedString {
+  return StringPool::global().intern(str);
+}
+
+} // namespace utils
+
+namespace std {
+
+template <>
+struct hash<utils::InternedString> {
+  auto operator()(const utils::InternedString& str) const noexcept -> std::size_t {
+    return str.id();
+  }
+};
+
+} // namespace std
+
+#endif // UTILS_STRINGPOOL_H_
@@ -0,0 +1,247 @@
+// SPDX-FileCopyrightText: 2024 Technical University of Munich
+//
+// SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef UTILS_STRINGREPLACER_H_
+#define UTILS_STRINGREPLACER_H_
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <queue>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace utils {
+
+/**
+ * Replaces all occurrences of a set of patterns in a single pass
+ *
+ * The patterns are compiled once into an Aho-Corasick automaton, so the same
+ * replacer can be applied to many strings. Matches are non-overlapping and
+ * chosen leftmost-longest: Of all matches starting at the same position the
+ * longest one wins.
+ *
+ * Example:
+ * <code>
+ * StringReplacer replacer({{"{rank}", "3"}, {"{step}", "0042"}});
+ * std::string name = replacer.replace("output-{rank}-{step}.h5");
+ * </code>
+ */
+class StringReplacer {
+  private:
+  using State = std::uint32_t;
+
+  static constexpr std::uint32_t NoMatch = ~static_cast<std::uint32_t>(0);
+
+  /** The replacement strings */
+  std::vector<std::string> m_to;
+
+  /** Length of each pattern */
+  std::vector<std::size_t> m_fromLength;
+
+  /** Maps each byte to its character class (0 for bytes not used in any pattern) */
+  std::array<std::uint16_t, 256> m_class{};
+
+  /** Number of character classes */
+  std::size_t m_numClasses{1};
+
+  /** Transitions of the automaton, m_numClasses entries per state */
+  std::vector<State> m_delta;
+
+  /** Depth of each state in the trie, i.e. the length of the prefix it represents */
+  std::vector<std::size_t> m_depth;
+
+  /** The longest pattern that is a suffix of the state (or NoMatch) */
+  std::vector<std::uint32_t> m_match;
+
+  /** Largest difference between replacement and pattern length */
+  std::size_t m_maxGrowth{0};
+
+  public:
+  StringReplacer() { compile({}); }
+
+  /**
+   * @param replacements Pairs of pattern and replacement. Empty patterns are
+   *  ignored. If a pattern is given more than once, the last replacement is used.
+   */
+  StringReplacer(const std::vector<std::pair<std::string, std::string>>& replacements) {
+    compile(replacements);
+  }
+
+  /**
+   * @return The number of (distinct) patterns
+   */
+  [[nodiscard]] auto size() const -> std::size_t { return m_to.size(); }
+
+  /**
+   * Replaces all patterns in str
+   */
+  [[nodiscard]] auto replace(std::string_view str) const -> std::string {
+    std::string result;
+    replace(str, result);
+    return result;
+  }
+
+  /**
+   * Replaces all patterns in str and stores the result in out
+   *
+   * The content of out is overwritten, but its capacity is reused. This allows
+   * to expand many strings without allocating memory for each of them.
+   */
+  void replace(std::string_view str, std::string& out) const {
+    out.clear();
+    if (m_maxGrowth == 0) {
+      // The result cannot be longer than the input
+      out.reserve(str.size());
+    } else {
+      // Compute the exact size in a first pass, so the output is allocated only once
+      std::size_t size = str.size();
+      forEachMatch(str, [&](std::size_t /*start*/, std::uint32_t pattern) {
+        size = size + m_to[pattern].size() - m_fromLength[pattern];
+      });
+      out.reserve(size);
+    }
+
+    // Start of the text that has not been copied yet
+    std::size_t copied = 0;
+    forEachMatch(str, [&](std::size_t start, std::uint32_t pattern) {
+      out.append(str, copied, start - copied);
+      out.append(m_to[pattern]);
+      copied = start + m_fromLength[pattern];
+    });
+
+    out.append(str, copied, std::string_view::npos);
+  }
+
+  private:
+  /**
+   * Calls func(start, pattern) for each (leftmost-longest, non-overlapping) match
+   * in increasing order of the start position
+   */
+  template <typename Func>
+  void forEachMatch(std::string_view str, Func&& func) const {
+    // Pending match which might still be replaced by a match that starts earlier
+    std::uint32_t pattern = NoMatch;
+    std::size_t patternStart = 0;
+
+    State state = 0;
+    std::size_t i = 0;
+    while (true) {
+      if (i == str.size()) {
+        if (pattern == NoMatch) {
+          break;
+        }
+      } else {
+        state = m_delta[state * m_numClasses + m_class[static_cast<unsigned char>(str[i])]];
+        ++i;
+
+        const std::uint32_t match = m_match[state];
+        if (match != NoMatch) {
+          const std::size_t start = i - m_fromLength[match];
+          // Matches are found in increasing order of their end, so the new one is longer
+          if (pattern == NoMatch || start <= patternStart) {
+            pattern = match;
+            patternStart = start;
+          }
+        }
+
+        // Continue as long as a longer match, starting not after the pending one, is possible
+        if (pattern == NoMatch || i - m_depth[state] <= patternStart) {
+          continue;
+        }
+      }
+
+      func(patternStart, pattern);
+
+      // Matches must not overlap, restart after the replaced pattern
+      i = patternStart + m_fromLength[pattern];
+      pattern = NoMatch;
+      state = 0;
+    }
+  }
+
+  void compile(const std::vector<std::pair<std::string, std::string>>& replacements) {
+    // Character classes
+    m_class.fill(0);
+    for (const auto& [from, to] : replacements) {
+      for (const char c : from) {
+        auto& cls = m_class[static_cast<unsigned char>(c)];
+        if (cls == 0) {
+          cls = static_cast<std::uint16_t>(m_numClasses++);
+        }
+      }
+    }
+
+    // Build the trie
+    std::vector<State> trie(m_numClasses, 0);
+    m_depth.assign(1, 0);
+    m_match.assign(1, NoMatch);
+    for (const auto& [from, to] : replacements) {
+      if (from.empty()) {
+        continue;
+      }
+
+      State state = 0;
+      for (const char c : from) {
+        const std::size_t index = state * m_numClasses + m_class[static_cast<unsigned char>(c)];
+        if (trie[index] == 0) {
+          trie[index] = static_cast<State>(m_depth.size());
+          trie.resize(trie.size() + m_numClasses, 0);
+          m_depth.push_back(m_depth[state] + 1);
+          m_match.push_back(NoMatch);
+        }
+        state = trie[index];
+      }
+
+      if (m_match[state] == NoMatch) {
+        m_match[state] = static_cast<std::uint32_t>(m_to.size());
+        m_to.push_back(to);
+        m_fromLength.push_back(from.size());
+      } else {
+        m_to[m_match[state]] = to;
+      }
+
+      if (to.size() > from.size()) {
+        m_maxGrowth = std::max(m_maxGrowth, to.size() - from.size());
+      }
+    }
+
+    // Convert the trie into a DFA (breadth first, so failure states are always complete)
+    m_delta = std::move(trie);
+    std::vector<State> fail(m_depth.size(), 0);
+    std::queue<State> queue;
+    for (std::size_t c = 0; c < m_numClasses; ++c) {
+      if (m_delta[c] != 0) {
+        queue.push(m_delta[c]);
+      }
+    }
+    while (!queue.empty()) {
+      const State state = queue.front();
+      queue.pop();
+
+      if (m_match[state] == NoMatch) {
+        // The longest pattern that is a suffix of the failure state
+        m_match[state] = m_match[fail[state]];
+      }
+
+      for (std::size_t c = 0; c < m_numClasses; ++c) {
+        State& next = m_delta[state * m_numClasses + c];
+        const State fallback = m_delta[fail[state] * m_numClasses + c];
+        if (next == 0) {
+          next = fallback;
+        } else {
+          fail[next] = fallback;
+          queue.push(next);
+        }
+      }
+    }
+  }
+};
+
+} // namespace utils
+
+#endif // UTILS_STRINGREPLACER_H_
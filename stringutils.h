@@ -7,13 +7,25 @@
 #ifndef UTILS_STRINGUTILS_H_
 #define UTILS_STRINGUTILS_H_
 
+#include "utils/stringbuilder.h"
+
 #include <algorithm>
 #include <cctype>
+#include <charconv>
+#include <cstdlib>
 #include <cstring>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif // __SSE2__
+
 /**
  * A collection of useful utility functions
  */
@@ -30,7 +42,7 @@ class StringUtils {
    * Taken from
    * http://stackoverflow.com/questions/3418231/c-replace-part-of-a-string-with-another-string
    */
-  static auto replace(std::string& str, const std::string& from, const std::string& to) -> bool {
+  static auto replace(std::string& str, std::string_view from, std::string_view to) -> bool {
     const size_t startPos = str.find(from);
     if (startPos == std::string::npos) {
       return false;
@@ -42,8 +54,7 @@ class StringUtils {
   /**
    * Replaces last occurrence of from in str with to
    */
-  static auto replaceLast(std::string& str, const std::string& from, const std::string& to)
-      -> bool {
+  static auto replaceLast(std::string& str, std::string_view from, std::string_view to) -> bool {
     const size_t startPos = str.rfind(from);
     if (startPos == std::string::npos) {
       return false;
@@ -52,7 +63,7 @@ class StringUtils {
     return true;
   }
 
-  static auto startsWith(const std::string& str, const std::string& prefix) -> bool {
+  static auto startsWith(std::string_view str, std::string_view prefix) -> bool {
     return str.size() >= prefix.size() && str.compare(0, prefix.size(), prefix) == 0;
   }
 
@@ -62,7 +73,7 @@ class StringUtils {
    * Taken from:
    * http://stackoverflow.com/questions/20446201/how-to-check-if-string-ends-with-txt
    */
-  static auto endsWith(const std::string& str, const std::string& suffix) -> bool {
+  static auto endsWith(std::string_view str, std::string_view suffix) -> bool {
     return str.size() >= suffix.size() &&
            str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
   }
@@ -70,29 +81,15 @@ class StringUtils {
   static auto padLeft(const std::string& str, std::size_t size, char padchar) -> std::string {
     if (str.size() >= size) {
       return str;
-    } else {
-      std::stringstream stream;
-      const std::size_t padlen = size - str.size();
-      for (std::size_t i = 0; i < padlen; ++i) {
-        stream << padchar;
-      }
-      stream << str;
-      return stream.str();
     }
+    return std::move(StringBuilder().reserve(size).appendPadLeft(str, size, padchar)).str();
   }
 
   static auto padRight(const std::string& str, std::size_t size, char padchar) -> std::string {
     if (str.size() >= size) {
       return str;
-    } else {
-      std::stringstream stream;
-      stream << str;
-      const std::size_t padlen = size - str.size();
-      for (std::size_t i = 0; i < padlen; ++i) {
-        stream << padchar;
-      }
-      return stream.str();
     }
+    return std::move(StringBuilder().reserve(size).appendPadRight(str, size, padchar)).str();
   }
 
   /**
@@ -143,6 +140,32 @@ class StringUtils {
     return elems;
   }
 
+  /**
+   * Converts a string to an integer or floating point number without
+   * allocating memory
+   *
+   * Leading and trailing white space and a leading '+' are ignored.
+   *
+   * @return False if str is not a valid number (value is not modified)
+   */
+  template <typename T>
+  static auto parseNumber(std::string_view str, T& value) -> bool {
+    static_assert(std::is_arithmetic_v<T> && !std::is_same_v<T, bool>,
+                  "Only integer and floating point numbers are supported");
+
+    str = trimView(str);
+    if (str.size() > 1 && str.front() == '+' && str[1] != '-') {
+      str.remove_prefix(1);
+    }
+
+    T result{};
+    if (str.empty() || !fromChars(str, result)) {
+      return false;
+    }
+    value = result;
+    return true;
+  }
+
   /**
    * Converts null terminated string to upper case
    */
@@ -180,34 +203,86 @@ class StringUtils {
   }
 
   /**
-   * Trims from start
+   * Converts the first n characters of s to upper case
    *
-   * Taken from
-   * http://stackoverflow.com/questions/216823/whats-the-best-way-to-trim-stdstring
+   * Only ASCII letters are converted; unlike toUpper() this does not depend on the locale.
+   */
+  static void toUpperAscii(char* s, std::size_t n) { flipCaseAscii(s, n, 'a'); }
+
+  static void toUpperAscii(std::string& str) { toUpperAscii(str.data(), str.size()); }
+
+  /**
+   * Converts the first n characters of s to lower case
+   *
+   * Only ASCII letters are converted; unlike toLower() this does not depend on the locale.
+   */
+  static void toLowerAscii(char* s, std::size_t n) { flipCaseAscii(s, n, 'A'); }
+
+  static void toLowerAscii(std::string& str) { toLowerAscii(str.data(), str.size()); }
+
+  /**
+   * Compares two strings ignoring the case of ASCII letters
+   */
+  static auto equalsIgnoreCase(std::string_view a, std::string_view b) -> bool {
+    if (a.size() != b.size()) {
+      return false;
+    }
+    for (std::size_t i = 0; i < a.size(); ++i) {
+      if (lowerAscii(a[i]) != lowerAscii(b[i])) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /**
+   * @return True if c is a white-space character in the "C" locale
+   */
+  static constexpr auto isSpaceAscii(char c) -> bool {
+    return c == ' ' || static_cast<unsigned char>(c - '\t') <= '\r' - '\t';
+  }
+
+  /**
+   * @return A view on str without leading white-space
+   */
+  static auto ltrimView(std::string_view str) -> std::string_view {
+    str.remove_prefix(findNotSpace(str));
+    return str;
+  }
+
+  /**
+   * @return A view on str without trailing white-space
+   */
+  static auto rtrimView(std::string_view str) -> std::string_view {
+    str.remove_suffix(str.size() - findLastNotSpace(str));
+    return str;
+  }
+
+  /**
+   * @return A view on str without leading and trailing white-space
+   */
+  static auto trimView(std::string_view str) -> std::string_view {
+    return ltrimView(rtrimView(str));
+  }
+
+  /**
+   * Trims from start
    */
   static auto ltrim(std::string& s) -> std::string& {
-    const auto notSpace = [](unsigned char ch) { return std::isspace(ch) == 0; };
-    s.erase(s.begin(), std::find_if(s.begin(), s.end(), notSpace));
+    s.erase(0, findNotSpace(s));
     return s;
   }
 
   /**
    * Trims from end
-   *
-   * Taken from
-   * http://stackoverflow.com/questions/216823/whats-the-best-way-to-trim-stdstring
    */
   static auto rtrim(std::string& s) -> std::string& {
-    const auto notSpace = [](unsigned char ch) { return std::isspace(ch) == 0; };
-    s.erase(std::find_if(s.rbegin(), s.rend(), notSpace).base(), s.end());
+    s.erase(findLastNotSpace(s));
     return s;
   }
 
   /**
    * Trims from both ends
-   *
-   * Taken from
-   * http://stackoverflow.com/questions/216823/whats-the-best-way-to-trim-stdstring
    */
   static auto trim(std::string& s) -> std::string& { return ltrim(rtrim(s)); }
 
@@ -219,15 +294,24 @@ class StringUtils {
    */
   template <typename T>
   static auto join(const std::vector<T>& v, const std::string& token) -> std::string {
-    std::ostringstream result;
+    StringBuilder builder;
+    if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+      // The exact size is known for strings
+      std::size_t size = v.empty() ? 0 : token.size() * (v.size() - 1);
+      for (const auto& elem : v) {
+        size += std::string_view(elem).size();
+      }
+      builder.reserve(size);
+    }
+
     for (auto i = v.begin(); i != v.end(); ++i) {
       if (i != v.begin()) {
-        result << token;
+        builder.append(token);
       }
-      result << *i;
+      appendValue(builder, *i);
     }
 
-    return result.str();
+    return std::move(builder).str();
   }
 
   /**
@@ -247,6 +331,143 @@ class StringUtils {
 
     return elems;
   }
+
+  private:
+  template <typename T>
+  static auto fromChars(std::string_view str, T& value) -> bool {
+    const char* last = str.data() + str.size();
+    const auto [ptr, error] = std::from_chars(str.data(), last, value);
+    return error == std::errc() && ptr == last;
+  }
+
+#ifndef __cpp_lib_to_chars
+  // Older standard libraries do not support std::from_chars for floating point numbers
+  static auto fromChars(std::string_view str, float& value) -> bool {
+    return strToFloat(str, value);
+  }
+
+  static auto fromChars(std::string_view str, double& value) -> bool {
+    return strToFloat(str, value);
+  }
+
+  static auto fromChars(std::string_view str, long double& value) -> bool {
+    return strToFloat(str, value);
+  }
+
+  template <typename T>
+  static auto strToFloat(std::string_view str, T& value) -> bool {
+    char buffer[128];
+    if (str.size() >= sizeof(buffer)) {
+      return false;
+    }
+    std::memcpy(buffer, str.data(), str.size());
+    buffer[str.size()] = '\0';
+    char* end = nullptr;
+    value = static_cast<T>(std::strtold(buffer, &end));
+    return end == buffer + str.size();
+  }
+#endif // __cpp_lib_to_chars
+
+  /**
+   * Appends value in the same format as <code>std::ostream::operator<<</code>
+   */
+  template <typename T>
+  static void appendValue(StringBuilder& builder, const T& value) {
+    if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+      builder.append(std::string_view(value));
+    } else if constexpr (std::is_same_v<T, char> || std::is_same_v<T, signed char> ||
+                         std::is_same_v<T, unsigned char>) {
+      builder.append(static_cast<char>(value));
+    } else if constexpr (std::is_same_v<T, bool>) {
+      builder.append(value ? '1' : '0');
+    } else if constexpr (std::is_integral_v<T>) {
+      builder.appendNumber(value);
+    } else if constexpr (std::is_floating_point_v<T>) {
+      builder.appendNumber(value, std::chars_format::general, 6);
+    } else {
+      builder.append(toString(value));
+    }
+  }
+
+  static constexpr auto lowerAscii(char c) -> char {
+    return static_cast<unsigned char>(c - 'A') < 26 ? static_cast<char>(c | 0x20) : c;
+  }
+
+  /**
+   * Flips the case of all characters in [first, first + 26) which must be a range of ASCII letters
+   */
+  static void flipCaseAscii(char* s, std::size_t n, char first) {
+    std::size_t i = 0;
+#ifdef __SSE2__
+    // Shift the range [first, first + 26) to [-128, -102) so one signed compare suffices
+    const __m128i shift = _mm_set1_epi8(static_cast<char>(-128 - first));
+    const __m128i limit = _mm_set1_epi8(static_cast<char>(-128 + 26));
+    const __m128i caseBit = _mm_set1_epi8(0x20);
+    for (; i + 16 <= n; i += 16) {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+      const __m128i letter = _mm_cmplt_epi8(_mm_add_epi8(v, shift), limit);
+      v = _mm_xor_si128(v, _mm_and_si128(letter, caseBit));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(s + i), v);
+    }
+#endif // __SSE2__
+    for (; i < n; ++i) {
+      const bool letter = static_cast<unsigned char>(s[i] - first) < 26;
+      s[i] = static_cast<char>(s[i] ^ (letter ? 0x20 : 0));
+    }
+  }
+
+#ifdef __SSE2__
+  /**
+   * @return A bit mask with one bit for each of the 16 characters that is not white-space
+   */
+  static auto notSpaceMask(const char* s) -> unsigned {
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s));
+    const __m128i space = _mm_cmpeq_epi8(v, _mm_set1_epi8(' '));
+    // '\t' ... '\r' are consecutive, use the same trick as in flipCaseAscii
+    const __m128i shift = _mm_set1_epi8(static_cast<char>(-128 - '\t'));
+    const __m128i limit = _mm_set1_epi8(-128 + ('\r' - '\t' + 1));
+    const __m128i control = _mm_cmplt_epi8(_mm_add_epi8(v, shift), limit);
+    return ~static_cast<unsigned>(_mm_movemask_epi8(_mm_or_si128(space, control))) & 0xFFFFU;
+  }
+#endif // __SSE2__
+
+  /**
+   * @return The position of the first non white-space character or str.size()
+   */
+  static auto findNotSpace(std::string_view str) -> std::size_t {
+    std::size_t i = 0;
+#ifdef __SSE2__
+    for (; i + 16 <= str.size(); i += 16) {
+      const unsigned mask = notSpaceMask(str.data() + i);
+      if (mask != 0) {
+        return i + __builtin_ctz(mask);
+      }
+    }
+#endif // __SSE2__
+    while (i < str.size() && isSpaceAscii(str[i])) {
+      ++i;
+    }
+    return i;
+  }
+
+  /**
+   * @return The position after the last non white-space character or 0
+   */
+  static auto findLastNotSpace(std::string_view str) -> std::size_t {
+    std::size_t i = str.size();
+#ifdef __SSE2__
+    for (; i >= 16; i -= 16) {
+      const unsigned mask = notSpaceMask(str.data() + i - 16);
+      if (mask != 0) {
+        return i - 16 + (32 - __builtin_clz(mask));
+      }
+    }
+#endif // __SSE2__
+    while (i > 0 && isSpaceAscii(str[i - 1])) {
+      --i;
+    }
+    return i;
+  }
 };
 
 template <>
@@ -261,14 +482,12 @@ inline auto StringUtils::parse(const std::string& str) -> const char* {
 
 template <>
 inline auto StringUtils::parse(const std::string& str) -> bool {
-  std::string s = str;
-  toLower(s);
-  trim(s);
+  const std::string_view s = trimView(str);
 
-  if (s == "on" || s == "yes" || s == "true") {
+  if (equalsIgnoreCase(s, "on") || equalsIgnoreCase(s, "yes") || equalsIgnoreCase(s, "true")) {
     return true;
   }
-  if (s == "off" || s == "no" || s == "false") {
+  if (equalsIgnoreCase(s, "off") || equalsIgnoreCase(s, "no") || equalsIgnoreCase(s, "false")) {
     return false;
   }
 
@@ -0,0 +1,134 @@
+// SPDX-FileCopyrightText: 2024 Technical University of Munich
+//
+// SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef UTILS_TESTS_ALLOCATIONCOUNTER_H_
+#define UTILS_TESTS_ALLOCATIONCOUNTER_H_
+
+// Replaces all global operators new and delete to count heap allocations
+// Include this only in tests that check for allocations (once per executable)
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+namespace utils::tests {
+
+inline std::atomic<std::size_t> allocationCount{0};
+
+/**
+ * Counts the heap allocations during its lifetime
+ */
+class AllocationCounter {
+  private:
+  std::size_t m_start;
+
+  public:
+  AllocationCounter() : m_start(allocationCount.load()) {}
+
+  [[nodiscard]] auto count() const -> std::size_t { return allocationCount.load() - m_start; }
+};
+
+} // namespace utils::tests
+
+namespace utils::tests {
+
+/**
+ * Counts and performs an allocation (all replaced operators use malloc and free)
+ */
+inline auto countedAllocate(std::size_t size, std::size_t alignment) noexcept -> void* {
+  ++allocationCount;
+  if (size == 0) {
+    size = 1;
+  }
+  if (alignment <= alignof(std::max_align_t)) {
+    return std::malloc(size);
+  }
+  // aligned_alloc requires a multiple of the alignment
+  return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+}
+
+inline auto countedAllocateOrThrow(std::size_t size, std::size_t alignment) -> void* {
+  void* ptr = countedAllocate(size, alignment);
+  if (ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+} // namespace utils::tests
+
+auto operator new(std::size_t size) -> void* {
+  return utils::tests::countedAllocateOrThrow(size, alignof(std::max_align_t));
+}
+
+auto operator new[](std::size_t size) -> void* {
+  return utils::tests::countedAllocateOrThrow(size, alignof(std::max_align_t));
+}
+
+auto operator new(std::size_t size, std::align_val_t alignment) -> void* {
+  return utils::tests::countedAllocateOrThrow(size, static_cast<std::size_t>(alignment));
+}
+
+auto operator new[](std::size_t size, std::align_val_t alignment) -> void* {
+  return utils::tests::countedAllocateOrThrow(size, static_cast<std::size_t>(alignment));
+}
+
+auto operator new(std::size_t size, const std::nothrow_t& /*tag*/) noexcept -> void* {
+  return utils::tests::countedAllocate(size, alignof(std::max_align_t));
+}
+
+auto operator new[](std::size_t size, const std::nothrow_t& /*tag*/) noexcept -> void* {
+  return utils::tests::countedAllocate(size, alignof(std::max_align_t));
+}
+
+auto operator new(std::size_t size,
+                  std::align_val_t alignment,
+                  const std::nothrow_t& /*tag*/) noexcept -> void* {
+  return utils::tests::countedAllocate(size, static_cast<std::size_t>(alignment));
+}
+
+auto operator new[](std::size_t size,
+                    std::align_val_t alignment,
+                    const std::nothrow_t& /*tag*/) noexcept -> void* {
+  return utils::tests::countedAllocate(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+
+void operator delete[](void* ptr) noexcept { std::free(ptr); }
+
+void operator delete(void* ptr, std::size_t /*size*/) noexcept { std::free(ptr); }
+
+void operator delete[](void* ptr, std::size_t /*size*/) noexcept { std::free(ptr); }
+
+void operator delete(void* ptr, std::align_val_t /*alignment*/) noexcept { std::free(ptr); }
+
+void operator delete[](void* ptr, std::align_val_t /*alignment*/) noexcept { std::free(ptr); }
+
+void operator delete(void* ptr, std::size_t /*size*/, std::align_val_t /*alignment*/) noexcept {
+  std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t /*size*/, std::align_val_t /*alignment*/) noexcept {
+  std::free(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t& /*tag*/) noexcept { std::free(ptr); }
+
+void operator delete[](void* ptr, const std::nothrow_t& /*tag*/) noexcept { std::free(ptr); }
+
+void operator delete(void* ptr,
+                     std::align_val_t /*alignment*/,
+                     const std::nothrow_t& /*tag*/) noexcept {
+  std::free(ptr);
+}
+
+void operator delete[](void* ptr,
+                       std::align_val_t /*alignment*/,
+                       const std::nothrow_t& /*tag*/) noexcept {
+  std::free(ptr);
+}
+
+#endif // UTILS_TESTS_ALLOCATIONCOUNTER_H_
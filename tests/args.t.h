@@ -8,6 +8,11 @@
 #define UTILS_TESTS_ARGS_T_H_
 
 #include "utils/args.h"
+#include "allocationcounter.h"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
 
 using namespace utils;
 
@@ -33,5 +38,297 @@ class TestArgs : public CxxTest::TestSuite {
 
     // TODO add more tests to cover all possibilities
   }
+
+  static void testInterned() {
+    const char* argv[] = {"prog", "--order", "4", "-v"};
+
+    Args args("");
+    args.addOption("order", 'o', "");
+    args.addOption("verbose", 'v', "", Args::No, false);
+    args.addOption("unused", 'u', "", Args::Required, false);
+
+    TS_ASSERT_EQUALS(args.parse(4, const_cast<char**>(argv), false), Args::Success);
+
+    const InternedString order = intern("order");
+    TS_ASSERT(args.isSet(order));
+    TS_ASSERT_EQUALS(args.getArgument<int>(order), 4);
+    TS_ASSERT_EQUALS(args.getArgument<int>("order"), 4);
+    TS_ASSERT(args.getArgument(intern("verbose"), false));
+    TS_ASSERT(!args.isSet("unused"));
+    TS_ASSERT(!args.isSet("never-interned-option"));
+    TS_ASSERT_EQUALS(args.getArgument(intern("unused"), 7), 7);
+  }
+
+  static void testBind() {
+    const char* argv[] = {"prog", "--order", "4", "--dt=0.5"};
+
+    Args args("");
+    args.addOption("order", 'o', "");
+    args.addOption("dt", 0, "");
+    args.addOption("end", 'e', "", Args::Required, false);
+    TS_ASSERT_EQUALS(args.parse(4, const_cast<char**>(argv), false), Args::Success);
+
+    const auto order = args.bind<int>("order", 0);
+    const auto end = args.bind<double>("end", 10.0);
+    TS_ASSERT_EQUALS(*order, 4);
+    TS_ASSERT_EQUALS(*end, 10.0);
+
+    // Same name, different types
+    TS_ASSERT_EQUALS(args.getArgument<double>("dt"), 0.5);
+    TS_ASSERT_EQUALS(args.getArgument<int>("dt"), 0);
+    TS_ASSERT_EQUALS(args.getArgument<std::string>("dt"), "0.5");
+  }
+
+  static void testNoAllocation() {
+    const char* argv[] = {"prog", "--order=4", "-v", "mesh"};
+
+    Args args("");
+    args.addOption("order", 'o', "");
+    args.addOption("verbose", 'v', "", Args::No, false);
+    args.addAdditionalOption("input", "");
+    TS_ASSERT_EQUALS(args.parse(4, const_cast<char**>(argv), false), Args::Success);
+
+    const tests::AllocationCounter counter;
+    TS_ASSERT(args.isSet("order"));
+    TS_ASSERT(!args.isSet("unknown"));
+    TS_ASSERT(args.isSetAdditional("input"));
+    TS_ASSERT(args.getArgument("verbose", false));
+    TS_ASSERT_EQUALS(counter.count(), 0);
+
+    // Parsed only once
+    TS_ASSERT_EQUALS(args.getArgument<int>("order"), 4);
+    const tests::AllocationCounter cached;
+    TS_ASSERT_EQUALS(args.getArgument<int>("order"), 4);
+    TS_ASSERT_EQUALS(args.getArgument<int>(intern("order")), 4);
+    TS_ASSERT_EQUALS(cached.count(), 0);
+  }
+
+  static void testSyntax() {
+    Args args("");
+    args.addOption("order", 'o', "");
+    args.addOption("output", 'w', "", Args::Optional, false);
+    args.addOption("verbose", 'v', "", Args::No, false);
+    args.addOption("xdmf", 'x', "", Args::No, false);
+    args.addAdditionalOption("input", "");
+    args.addAdditionalOption("extra", "", false);
+
+    const char* argv1[] = {"prog", "-vxo3", "mesh", "--output=out", "--", "-x"};
+    TS_ASSERT_EQUALS(args.parse(6, const_cast<char**>(argv1), false), Args::Success);
+    TS_ASSERT(args.isSet("verbose"));
+    TS_ASSERT(args.isSet("xdmf"));
+    TS_ASSERT_EQUALS(args.getArgument<int>("order"), 3);
+    TS_ASSERT_EQUALS(args.getArgument<std::string>("output"), "out");
+    TS_ASSERT_EQUALS(args.getAdditionalArgument<std::string>("input"), "mesh");
+    TS_ASSERT_EQUALS(args.getAdditionalArgument<std::string>("extra"), "-x");
+
+    // Reparsing resets everything; unique prefixes are accepted
+    const char* argv2[] = {"prog", "--ord", "5", "--outp", "mesh", "-w"};
+    TS_ASSERT_EQUALS(args.parse(6, const_cast<char**>(argv2), false), Args::Success);
+    TS_ASSERT(!args.isSet("verbose"));
+    TS_ASSERT_EQUALS(args.getArgument<int>("order"), 5);
+    TS_ASSERT_EQUALS(args.getArgument<std::string>("output"), "");
+    TS_ASSERT(!args.isSetAdditional("extra"));
+
+    const char* ambiguous[] = {"prog", "--o", "5", "mesh"};
+    TS_ASSERT_EQUALS(args.parse(4, const_cast<char**>(ambiguous), false), Args::Error);
+    const char* unknown[] = {"prog", "-o", "5", "-y", "mesh"};
+    TS_ASSERT_EQUALS(args.parse(5, const_cast<char**>(unknown), false), Args::Error);
+    const char* missing[] = {"prog", "mesh", "-o"};
+    TS_ASSERT_EQUALS(args.parse(3, const_cast<char**>(missing), false), Args::Error);
+    const char* flag[] = {"prog", "-o", "1", "--verbose=1", "mesh"};
+    TS_ASSERT_EQUALS(args.parse(5, const_cast<char**>(flag), false), Args::Error);
+  }
+
+  static void testMultipleParsers() {
+    const char* argv[] = {"prog", "-n", "2", "-h"};
+
+    for (int i = 0; i < 2; i++) {
+      Args outer("");
+      outer.addOption("count", 'n', "");
+      TS_ASSERT_EQUALS(outer.parse(3, const_cast<char**>(argv), false), Args::Success);
+
+      Args inner("");
+      inner.addOption("num", 'n', "");
+      TS_ASSERT_EQUALS(inner.parse(4, const_cast<char**>(argv), false), Args::Help);
+      TS_ASSERT_EQUALS(inner.parse(3, const_cast<char**>(argv), false), Args::Success);
+      TS_ASSERT_EQUALS(inner.getArgument<int>("num"), 2);
+      TS_ASSERT_EQUALS(outer.getArgument<int>("count"), 2);
+    }
+  }
+
+  static void testResponseFile() {
+    {
+      std::ofstream file("args.t.rsp");
+      file << "# generated\n-o 3 --output='my file' \"a\\\"b\"\n@args.t.inc\n";
+      std::ofstream include("args.t.inc");
+      include << "-v\nmesh\n";
+    }
+
+    Args args("");
+    args.addOption("order", 'o', "");
+    args.addOption("output", 'w', "", Args::Optional, false);
+    args.addOption("verbose", 'v', "", Args::No, false);
+    args.addAdditionalOption("name", "");
+    args.addAdditionalOption("input", "");
+
+    const char* argv[] = {"prog", "@args.t.rsp", "-o", "4"};
+    // Response files are disabled by default
+    TS_ASSERT_EQUALS(args.parse(4, const_cast<char**>(argv), false), Args::Error);
+
+    args.enableResponseFiles();
+    TS_ASSERT_EQUALS(args.parse(4, const_cast<char**>(argv), false), Args::Success);
+    TS_ASSERT_EQUALS(args.getArgument<int>("order"), 4);
+    TS_ASSERT_EQUALS(args.getArgument<std::string>("output"), "my file");
+    TS_ASSERT(args.isSet("verbose"));
+    TS_ASSERT_EQUALS(args.getAdditionalArgument<std::string>("name"), "a\"b");
+    TS_ASSERT_EQUALS(args.getAdditionalArgument<std::string>("input"), "mesh");
+
+    const char* missing[] = {"prog", "@does-not-exist"};
+    TS_ASSERT_EQUALS(args.parse(2, const_cast<char**>(missing), false), Args::Error);
+
+    std::remove("args.t.rsp");
+    std::remove("args.t.inc");
+  }
+
+  static void testConfigOption() {
+    {
+      std::ofstream file("args.t.cfg");
+      file << "# comment\n\norder = 3\n  verbose\noutput=out\n";
+    }
+
+    Args args("");
+    args.addOption("order", 'o', "");
+    args.addOption("output", 'w', "", Args::Optional, false);
+    args.addOption("verbose", 'v', "", Args::No, false);
+    args.addConfigOption("config", 'c');
+
+    const char* argv1[] = {"prog", "--config", "args.t.cfg"};
+    TS_ASSERT_EQUALS(args.parse(3, const_cast<char**>(argv1), false), Args::Success);
+    TS_ASSERT_EQUALS(args.getArgument<int>("order"), 3);
+    TS_ASSERT_EQUALS(args.getArgument<std::string>("output"), "out");
+    TS_ASSERT(args.isSet("verbose"));
+
+    // Options are applied in order
+    const char* argv2[] = {"prog", "-o", "1", "-cargs.t.cfg", "--order=5"};
+    TS_ASSERT_EQUALS(args.parse(5, const_cast<char**>(argv2), false), Args::Success);
+    TS_ASSERT_EQUALS(args.getArgument<int>("order"), 5);
+
+    {
+      std::ofstream file("args.t.cfg");
+      file << "unknown = 1\n";
+    }
+    TS_ASSERT_EQUALS(args.parse(3, const_cast<char**>(argv1), false), Args::Error);
+
+    std::remove("args.t.cfg");
+  }
+
+  static void testCString() {
+    const char* argv[] = {"prog", "--name=mesh", "-o", "3", "input"};
+
+    Args args("");
+    args.addOption("name", 0, "");
+    args.addOption("order", 'o', "");
+    args.addAdditionalOption("file", "");
+    TS_ASSERT_EQUALS(args.parse(5, const_cast<char**>(argv), false), Args::Success);
+
+    const char* name = args.getArgument<const char*>("name");
+    TS_ASSERT_EQUALS(std::string(name), "mesh");
+    TS_ASSERT_EQUALS(args.getArgument<int>("order"), 3);
+    TS_ASSERT_EQUALS(std::string(args.getAdditionalArgument<const char*>("file")), "input");
+
+    // The cached pointer stays valid
+    TS_ASSERT_EQUALS(args.getArgument<const char*>("name"), name);
+    TS_ASSERT_EQUALS(std::string(args.getArgument<const char*>("name")), "mesh");
+  }
+
+  static void testSubcommand() {
+    int constructed = 0;
+
+    Args args("Tools");
+    args.addOption("verbose", 'v', "", Args::No, false);
+    args.addSubcommand("partition", "Partition a mesh", [&constructed](Args& sub) {
+      constructed++;
+      sub.addOption("parts", 'p', "Number of partitions");
+      sub.addAdditionalOption("mesh", "The mesh");
+    });
+    args.addSubcommand("convert", "Convert a mesh", [&constructed](Args& sub) {
+      constructed++;
+      sub.addOption("format", 'f', "");
+    });
+
+    std::ostringstream help;
+    args.helpMessage("prog", help);
+    TS_ASSERT_EQUALS(constructed, 0);
+    TS_ASSERT_DIFFERS(help.str().find("<command> [<args>]"), std::string::npos);
+    TS_ASSERT_DIFFERS(help.str().find("  partition"), std::string::npos);
+
+    const char* argv[] = {"prog", "-v", "partition", "-p", "4", "mesh.h5", "-v"};
+    TS_ASSERT_EQUALS(args.parse(6, const_cast<char**>(argv), false), Args::Success);
+    TS_ASSERT_EQUALS(constructed, 1);
+    TS_ASSERT(args.isSet("verbose"));
+    TS_ASSERT_EQUALS(args.subcommand(), "partition");
+    TS_ASSERT_EQUALS(args.subcommandArgs().getArgument<int>("parts"), 4);
+    TS_ASSERT_EQUALS(args.subcommandArgs().getAdditionalArgument<std::string>("mesh"), "mesh.h5");
+
+    // The parser of the subcommand is reused
+    TS_ASSERT_EQUALS(args.parse(6, const_cast<char**>(argv), false), Args::Success);
+    TS_ASSERT_EQUALS(constructed, 1);
+
+    // Options of the parent are not known by the subcommand
+    TS_ASSERT_EQUALS(args.parse(7, const_cast<char**>(argv), false), Args::Error);
+
+    const char* help1[] = {"prog", "partition", "--help"};
+    TS_ASSERT_EQUALS(args.parse(3, const_cast<char**>(help1), false), Args::Help);
+    const char* missing[] = {"prog", "-v"};
+    TS_ASSERT_EQUALS(args.parse(2, const_cast<char**>(missing), false), Args::Error);
+    TS_ASSERT_EQUALS(args.subcommand(), "");
+    const char* unknown[] = {"prog", "run"};
+    TS_ASSERT_EQUALS(args.parse(2, const_cast<char**>(unknown), false), Args::Error);
+    TS_ASSERT_EQUALS(constructed, 1);
+  }
+
+  static void testList() {
+    Args args("");
+    args.addListOption("receivers", 'r', "");
+    args.addListOption("input", 'i', "", 0);
+    args.addListOption("empty", 'e', "");
+    args.addOption("order", 'o', "", Args::Required, false);
+
+    const char* argv[] = {
+        "prog", "--receivers", "1.5,2, 3", "-i", "a,b", "-r4", "--input=c", "-o", " 7 "};
+    TS_ASSERT_EQUALS(args.parse(9, const_cast<char**>(argv), false), Args::Success);
+
+    const std::vector<double>& receivers = args.getList<double>("receivers");
+    TS_ASSERT_EQUALS(receivers.size(), 4U);
+    TS_ASSERT_DELTA(receivers[0], 1.5, 1e-15);
+    TS_ASSERT_DELTA(receivers[3], 4.0, 1e-15);
+    // Parsed only once
+    TS_ASSERT_EQUALS(&args.getList<double>("receivers"), &receivers);
+    TS_ASSERT_EQUALS(args.getList<int>("receivers").size(), 4U);
+    TS_ASSERT_EQUALS(args.getList<int>("receivers")[2], 3);
+
+    const auto& input = args.getList<std::string_view>("input");
+    TS_ASSERT_EQUALS(input.size(), 2U);
+    TS_ASSERT_EQUALS(input[0], "a,b");
+    TS_ASSERT_EQUALS(args.getList<std::string>("input")[1], "c");
+
+    TS_ASSERT(!args.isSet("empty"));
+    TS_ASSERT(args.getList<int>("empty").empty());
+    TS_ASSERT_EQUALS(args.getArgument<int>("order"), 7);
+  }
+
+  static void testCharacter() {
+    const char* argv[] = {"prog", "-s", "5", "x"};
+
+    Args args("");
+    args.addOption("separator", 's', "");
+    args.addAdditionalOption("mode", "");
+    TS_ASSERT_EQUALS(args.parse(4, const_cast<char**>(argv), false), Args::Success);
+
+    // Characters are not parsed as numbers
+    TS_ASSERT_EQUALS(args.getArgument<char>("separator"), '5');
+    TS_ASSERT_EQUALS(args.getArgument<int>("separator"), 5);
+    TS_ASSERT_EQUALS(args.getAdditionalArgument<char>("mode"), 'x');
+  }
 };
 #endif // UTILS_TESTS_ARGS_T_H_
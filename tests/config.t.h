@@ -0,0 +1,105 @@
+// SPDX-FileCopyrightText: 2024 Technical University of Munich
+//
+// SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef UTILS_TESTS_CONFIG_T_H_
+#define UTILS_TESTS_CONFIG_T_H_
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+#include "utils/config.h"
+
+using namespace utils;
+
+class TestConfig : public CxxTest::TestSuite {
+  public:
+  static void testResolve() {
+    const char* filename = "config.t.cfg";
+    {
+      std::ofstream file(filename);
+      file << "# test configuration\n"
+           << "order = 5\n"
+           << "end-time=2.5\n"
+           << "\n"
+           << "output = from-file\n";
+    }
+
+    TS_ASSERT_EQUALS(setenv("UTILS_CONFIG_END_TIME", "3.5", 1), 0);
+    TS_ASSERT_EQUALS(setenv("UTILS_CONFIG_OUTPUT", "from-env", 1), 0);
+    Env::refresh();
+
+    const char* argv[] = {"prog", "--output", "from-args", "--verbose"};
+    Args args("");
+    args.addOption("output", 'o', "", Args::Required, false);
+    args.addOption("verbose", 'v', "", Args::No, false);
+    TS_ASSERT_EQUALS(args.parse(4, const_cast<char**>(argv), false), Args::Success);
+
+    ConfigBuilder builder;
+    builder.declare("order", 4, "Convergence order")
+        .declare("end-time", 1.0)
+        .declare("output", std::string("default"))
+        .declare("verbose", false)
+        .declare("cells", 100UL)
+        .addEnv("UTILS_CONFIG_")
+        .addArgs(args);
+    TS_ASSERT(builder.addFile(filename));
+    TS_ASSERT(!builder.addFile("does-not-exist.cfg"));
+    const Config config = builder.resolve();
+    std::remove(filename);
+
+    TS_ASSERT_EQUALS(config.get<int>("order"), 5);
+    TS_ASSERT_EQUALS(config.source("order"), Config::Source::File);
+    TS_ASSERT_EQUALS(config.get<double>("end-time"), 3.5);
+    TS_ASSERT_EQUALS(config.source("end-time"), Config::Source::Env);
+    TS_ASSERT_EQUALS(config.getString("output"), "from-args");
+    TS_ASSERT_EQUALS(config.source("output"), Config::Source::Args);
+    TS_ASSERT(config.get<bool>("verbose"));
+    TS_ASSERT_EQUALS(config.get<unsigned long>("cells"), 100);
+    TS_ASSERT_EQUALS(config.get<double>("cells"), 100.0);
+    TS_ASSERT_EQUALS(config.source("cells"), Config::Source::Default);
+    TS_ASSERT(!config.contains("unknown"));
+
+    std::ostringstream dump;
+    config.dump(dump);
+    TS_ASSERT_EQUALS(dump.str(),
+                     "cells = 100 # default\n"
+                     "end-time = 3.5 # env UTILS_CONFIG_END_TIME\n"
+                     "order = 5 # file config.t.cfg: Convergence order\n"
+                     "output = from-args # args --output\n"
+                     "verbose = true # args --verbose\n");
+  }
+
+  static void testInvalidValue() {
+    const char* filename = "config.t.invalid.cfg";
+    {
+      std::ofstream file(filename);
+      file << "threads = 8\n"
+           << "enabled = maybe\n";
+    }
+
+    TS_ASSERT_EQUALS(setenv("UTILS_CONFIG_INVALID_THREADS", "abc", 1), 0);
+    TS_ASSERT_EQUALS(setenv("UTILS_CONFIG_INVALID_TOLERANCE", "1e-3x", 1), 0);
+    Env::refresh();
+
+    ConfigBuilder builder;
+    builder.declare("threads", 4)
+        .declare("enabled", true)
+        .declare("tolerance", 1e-6)
+        .addEnv("UTILS_CONFIG_INVALID_");
+    TS_ASSERT(builder.addFile(filename));
+    const Config config = builder.resolve();
+    std::remove(filename);
+
+    // Invalid values are ignored, the next source is used
+    TS_ASSERT_EQUALS(config.get<int>("threads"), 8);
+    TS_ASSERT_EQUALS(config.source("threads"), Config::Source::File);
+    TS_ASSERT(config.get<bool>("enabled"));
+    TS_ASSERT_EQUALS(config.source("enabled"), Config::Source::Default);
+    TS_ASSERT_EQUALS(config.get<double>("tolerance"), 1e-6);
+    TS_ASSERT_EQUALS(config.source("tolerance"), Config::Source::Default);
+  }
+};
+#endif // UTILS_TESTS_CONFIG_T_H_
@@ -9,24 +9,125 @@
 
 #include <cstdlib>
 #include <cstring>
+#include <thread>
+#include <vector>
 
 #include "utils/env.h"
+#include "allocationcounter.h"
 
 using namespace utils;
 
 class TestEnv : public CxxTest::TestSuite {
   public:
   static void testGet() {
-    Env env("UTILS_");
     TS_ASSERT_EQUALS(setenv("UTILS_INT", "42", 1), 0);
+    TS_ASSERT_EQUALS(setenv("UTILS_BOOL", "1", 1), 0);
+    TS_ASSERT_EQUALS(setenv("UTILS_BOOL2", "0", 1), 0);
+    Env::refresh();
+
+    Env env("UTILS_");
     TS_ASSERT_EQUALS(env.get<int>("INT", 0), 42);
     TS_ASSERT_EQUALS(env.get("INT", "0"), std::string("42"));
     TS_ASSERT_EQUALS(env.get<int>("INT2", 3), 3);
 
-    TS_ASSERT_EQUALS(setenv("UTILS_BOOL", "1", 1), 0);
     TS_ASSERT_EQUALS(env.get<bool>("BOOL", false), true);
-    TS_ASSERT_EQUALS(setenv("UTILS_BOOL2", "0", 1), 0);
     TS_ASSERT_EQUALS(env.get<bool>("BOOL2", false), false);
   }
+
+  static void testGetInterned() {
+    TS_ASSERT_EQUALS(setenv("UTILS_INTERNED", "7", 1), 0);
+    Env::refresh();
+
+    Env env("UTILS_");
+    const InternedString name = intern("INTERNED");
+    TS_ASSERT_EQUALS(env.get(name, 0), 7);
+    TS_ASSERT_EQUALS(env.get("INTERNED", 0), 7);
+    TS_ASSERT_EQUALS(env.get(intern("INTERNED2"), "none"), std::string("none"));
+  }
+
+  static void testSnapshot() {
+    TS_ASSERT_EQUALS(setenv("UTILS_SNAPSHOT", "1", 1), 0);
+    TS_ASSERT_EQUALS(setenv("UTILS_SNAPSHOTX", "2", 1), 0);
+    Env::refresh();
+
+    Env env("UTILS_SNAPSHOT");
+    TS_ASSERT_EQUALS(env.get<int>("", 0), 1);
+    TS_ASSERT_EQUALS(env.get<int>("X", 0), 2);
+    TS_ASSERT_EQUALS(std::string(EnvSnapshot::get().get("UTILS_SNAPSHOTX")), "2");
+
+    const auto [first, last] = EnvSnapshot::get().range("UTILS_SNAPSHOT");
+    TS_ASSERT_EQUALS(last - first, 2);
+
+    // Only visible after a refresh
+    TS_ASSERT_EQUALS(setenv("UTILS_SNAPSHOT", "3", 1), 0);
+    TS_ASSERT_EQUALS(env.get<int>("", 0), 1);
+    Env::refresh();
+    TS_ASSERT_EQUALS(env.get<int>("", 0), 3);
+    TS_ASSERT_EQUALS(env.get(intern(""), 0), 3);
+
+    TS_ASSERT_EQUALS(unsetenv("UTILS_SNAPSHOT"), 0);
+    Env::refresh();
+    TS_ASSERT_EQUALS(env.get<int>("", 0), 0);
+    TS_ASSERT_EQUALS(env.get(intern(""), 0), 0);
+  }
+
+  static void testConcurrent() {
+    TS_ASSERT_EQUALS(setenv("UTILS_THREADS", "4", 1), 0);
+    Env::refresh();
+
+    const Env env("UTILS_");
+    std::vector<int> results(4);
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0; t < results.size(); t++) {
+      threads.emplace_back([&env, &results, t]() {
+        for (int i = 0; i < 1000; i++) {
+          results[t] += env.get<int>("THREADS", 0);
+        }
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+
+    for (const int result : results) {
+      TS_ASSERT_EQUALS(result, 4000);
+    }
+  }
+
+  static void testTyped() {
+    TS_ASSERT_EQUALS(setenv("UTILS_TYPED", "2.5", 1), 0);
+    Env::refresh();
+
+    Env env("UTILS_");
+    const InternedString name = intern("TYPED");
+    TS_ASSERT_EQUALS(env.get(name, 0.0), 2.5);
+    TS_ASSERT_EQUALS(env.get(name, 0), 2);
+    TS_ASSERT_EQUALS(env.get(name, std::string()), "2.5");
+
+    const auto typed = env.bind("TYPED", 1.0);
+    const auto missing = env.bind("TYPED_MISSING", 1.0);
+    TS_ASSERT_EQUALS(*typed, 2.5);
+    TS_ASSERT_EQUALS(*missing, 1.0);
+
+    TS_ASSERT_EQUALS(setenv("UTILS_TYPED", "3.5", 1), 0);
+    Env::refresh();
+    TS_ASSERT_EQUALS(env.get(name, 0.0), 3.5);
+    TS_ASSERT_EQUALS(*typed, 2.5);
+  }
+
+  static void testNoAllocation() {
+    TS_ASSERT_EQUALS(setenv("UTILS_SIZE", "80", 1), 0);
+    Env::refresh();
+
+    Env env("UTILS_");
+    TS_ASSERT_EQUALS(env.get<int>("SIZE", 0), 80);
+    TS_ASSERT_EQUALS(env.get<int>("MISSING", 3), 3);
+
+    const tests::AllocationCounter counter;
+    TS_ASSERT_EQUALS(env.get<int>("SIZE", 0), 80);
+    TS_ASSERT_EQUALS(env.get<int>("MISSING", 3), 3);
+    TS_ASSERT(env.getOptional<int>("SIZE").has_value());
+    TS_ASSERT_EQUALS(counter.count(), 0);
+  }
 };
 #endif // UTILS_TESTS_ENV_T_H_
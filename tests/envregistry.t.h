@@ -0,0 +1,94 @@
+// SPDX-FileCopyrightText: 2024 Technical University of Munich
+//
+// SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef UTILS_TESTS_ENVREGISTRY_T_H_
+#define UTILS_TESTS_ENVREGISTRY_T_H_
+
+#include <cstdlib>
+#include <sstream>
+
+#include "utils/envregistry.h"
+#include "allocationcounter.h"
+
+using namespace utils;
+
+constexpr EnvRegistry TestRegistry(
+    "UTILS_REGISTRY_",
+    {{"SIZE", EnvType::UInt, "80", "Width of the progress bar"},
+     {"OUTPUT", EnvType::String, "STDERR", "Output of the progress bar"},
+     {"ENABLED", EnvType::Bool, "yes", "Enable the feature"},
+     {"TOLERANCE", EnvType::Double, "1e-6", "Solver tolerance"},
+     {"ORDER", EnvType::Int, "4", "Convergence order"},
+     {"A", EnvType::Int, "0", ""},
+     {"B", EnvType::Int, "0", ""},
+     {"C", EnvType::Int, "0", ""},
+     {"D", EnvType::Int, "0", ""},
+     {"AB", EnvType::Int, "0", ""},
+     {"BA", EnvType::Int, "0", ""},
+     {"ABC", EnvType::Int, "0", ""}});
+
+static_assert(TestRegistry.size() == 12);
+static_assert(TestRegistry.contains("TOLERANCE"));
+static_assert(!TestRegistry.contains("TOLERANC"));
+static_assert(TestRegistry[TestRegistry.index("ORDER")].defaultValue == "4");
+
+class TestEnvRegistry : public CxxTest::TestSuite {
+  public:
+  static void testLookup() {
+    for (std::size_t i = 0; i < TestRegistry.size(); i++) {
+      TS_ASSERT_EQUALS(TestRegistry.index(TestRegistry[i].name), i);
+    }
+    TS_ASSERT(!TestRegistry.contains(""));
+    TS_ASSERT(!TestRegistry.contains("UTILS_REGISTRY_SIZE"));
+  }
+
+  static void testGet() {
+    TS_ASSERT_EQUALS(setenv("UTILS_REGISTRY_ORDER", "6", 1), 0);
+    Env::refresh();
+
+    TS_ASSERT_EQUALS(TestRegistry.get<int>("ORDER"), 6);
+    TS_ASSERT_EQUALS(TestRegistry.get<unsigned long>("SIZE"), 80);
+    TS_ASSERT_EQUALS(TestRegistry.get<double>("TOLERANCE"), 1e-6);
+    TS_ASSERT(TestRegistry.get<bool>("ENABLED"));
+    TS_ASSERT_EQUALS(std::string(TestRegistry.get<const char*>("OUTPUT")), "STDERR");
+  }
+
+  static void testResolveOnce() {
+    TS_ASSERT_EQUALS(setenv("UTILS_REGISTRY_ORDER", "6", 1), 0);
+    Env::refresh();
+    TS_ASSERT_EQUALS(TestRegistry.get<int>("ORDER"), 6);
+
+    const tests::AllocationCounter counter;
+    TS_ASSERT_EQUALS(TestRegistry.get<long>("ORDER"), 6);
+    TS_ASSERT_EQUALS(TestRegistry.get<std::string_view>("OUTPUT"), "STDERR");
+    TS_ASSERT_EQUALS(TestRegistry.get<float>("TOLERANCE"), 1e-6F);
+    TS_ASSERT_EQUALS(counter.count(), 0);
+
+    // Only visible after a refresh
+    TS_ASSERT_EQUALS(setenv("UTILS_REGISTRY_ORDER", "8", 1), 0);
+    TS_ASSERT_EQUALS(TestRegistry.get<int>("ORDER"), 6);
+    Env::refresh();
+    TS_ASSERT_EQUALS(TestRegistry.get<int>("ORDER"), 8);
+
+    // Invalid values fall back to the default
+    TS_ASSERT_EQUALS(setenv("UTILS_REGISTRY_ORDER", "abc", 1), 0);
+    Env::refresh();
+    TS_ASSERT_EQUALS(TestRegistry.get<int>("ORDER"), 4);
+    TS_ASSERT_EQUALS(TestRegistry.value("ORDER").value(), "abc");
+  }
+
+  static void testDump() {
+    TS_ASSERT_EQUALS(setenv("UTILS_REGISTRY_ORDER", "6", 1), 0);
+    Env::refresh();
+
+    std::ostringstream out;
+    TestRegistry.dump(out);
+    const std::string dump = out.str();
+    TS_ASSERT(dump.find("UTILS_REGISTRY_ORDER=6 # (int, set, default 4) Convergence order\n") !=
+              std::string::npos);
+    TS_ASSERT(dump.find("UTILS_REGISTRY_OUTPUT=STDERR # (string, default, default STDERR)") !=
+              std::string::npos);
+  }
+};
+#endif // UTILS_TESTS_ENVREGISTRY_T_H_
@@ -9,6 +9,17 @@
 
 #include "utils/mathutils.h"
 
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <iterator>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
 using namespace utils;
 
 class TestMathUtils : public CxxTest::TestSuite {
@@ -17,8 +28,337 @@ class TestMathUtils : public CxxTest::TestSuite {
     TS_ASSERT_EQUALS(MathUtils::roundUp(6, 4), 8);
     TS_ASSERT_EQUALS(MathUtils::roundUp(3, 3), 3);
     TS_ASSERT_EQUALS(MathUtils::roundUp(12, 10), 20);
+
+    static_assert(MathUtils::roundUp<64>(65UL) == 128UL);
+    TS_ASSERT_EQUALS(MathUtils::roundUp<4>(6), 8);
+    TS_ASSERT_EQUALS(MathUtils::roundUp<4>(8), 8);
+    TS_ASSERT_EQUALS(MathUtils::roundUp<1>(7), 7);
+    TS_ASSERT_EQUALS(MathUtils::roundUp<10>(12), 20);
+    TS_ASSERT_EQUALS(MathUtils::roundUp<4096>(std::size_t(1)), 4096U);
+  }
+
+  static void testInvariantDivisor() {
+    static_assert(InvariantDivisor(7).divide(50) == 7);
+
+    const std::uint32_t divisors[] = {1, 2, 3, 7, 10, 64, 641, 65535, 65536, 1000000007,
+                                      0x7FFFFFFF, 0x80000000, 0xFFFFFFFE, 0xFFFFFFFF};
+    for (const std::uint32_t d : divisors) {
+      const InvariantDivisor divisor(d);
+      const std::uint32_t edges[] = {0, 1, d - 1, d, d + 1, 0x7FFFFFFF, 0xFFFFFFFE, 0xFFFFFFFF};
+      for (const std::uint32_t a : edges) {
+        TS_ASSERT_EQUALS(divisor.divide(a), a / d);
+        TS_ASSERT_EQUALS(divisor.modulo(a), a % d);
+      }
+
+      // Sample of the full 32 bit range
+      for (std::uint64_t a = 0; a <= UINT32_MAX; a += 65521) {
+        const auto a32 = static_cast<std::uint32_t>(a);
+        TS_ASSERT_EQUALS(divisor.divide(a32), a32 / d);
+        TS_ASSERT_EQUALS(divisor.modulo(a32), a32 % d);
+        if (a32 <= UINT32_MAX - d) {
+          TS_ASSERT_EQUALS(divisor.roundUp(a32), MathUtils::roundUp<std::uint64_t>(a32, d));
+        }
+      }
+    }
+  }
+
+  static void testGcd() {
+    TS_ASSERT_EQUALS(MathUtils::gcd(6, 9), 3);
+    TS_ASSERT_EQUALS(MathUtils::gcd(9, 6), 3);
+    TS_ASSERT_EQUALS(MathUtils::gcd(0, 5), 5);
+    TS_ASSERT_EQUALS(MathUtils::gcd(5, 0), 5);
+    TS_ASSERT_EQUALS(MathUtils::gcd(0, 0), 0);
+    TS_ASSERT_EQUALS(MathUtils::gcd(-12, 18), 6);
+    TS_ASSERT_EQUALS(MathUtils::gcd(48UL, 1024UL), 16UL);
+    TS_ASSERT_EQUALS(MathUtils::gcd(1000000007LL, 998244353LL), 1LL);
+
+    // Usable at compile time
+    static_assert(MathUtils::gcd(96, 36) == 12);
+    static_assert(MathUtils::lcm(4, 6) == 12);
+  }
+
+  static void testLcm() {
+    TS_ASSERT_EQUALS(MathUtils::lcm(4, 6), 12);
+    TS_ASSERT_EQUALS(MathUtils::lcm(-4, 6), 12);
+    TS_ASSERT_EQUALS(MathUtils::lcm(0, 6), 0);
+    TS_ASSERT_EQUALS(MathUtils::lcm(65536U, 65536U), 65536U);
+    TS_ASSERT_THROWS(MathUtils::lcm(65536U, 65537U), std::overflow_error);
+    TS_ASSERT_THROWS(MathUtils::lcm(65536, 32769), std::overflow_error);
+  }
+
+  static void testRange() {
+    constexpr int Values[] = {84, 126, 210, 42, 294, 630};
+    static_assert(MathUtils::gcdRange(std::begin(Values), std::end(Values)) == 42);
+    static_assert(MathUtils::lcmRange(std::begin(Values), std::end(Values)) == 8820);
+
+    const std::vector<unsigned long> sizes = {16, 24, 40, 8, 64};
+    TS_ASSERT_EQUALS(MathUtils::gcdRange(sizes.begin(), sizes.end()), 8UL);
+    TS_ASSERT_EQUALS(MathUtils::lcmRange(sizes.begin(), sizes.end()), 960UL);
+    TS_ASSERT_EQUALS(MathUtils::gcdRange(sizes.begin(), sizes.begin()), 0UL);
+    TS_ASSERT_EQUALS(MathUtils::lcmRange(sizes.begin(), sizes.begin()), 1UL);
+
+    const std::vector<int> coprime = {6, 10, 15, 7, 9};
+    TS_ASSERT_EQUALS(MathUtils::gcdRange(coprime.begin(), coprime.end()), 1);
   }
 
-  static void testGcd() { TS_ASSERT_EQUALS(MathUtils::gcd(6, 9), 3); }
+  static void testBits() {
+    static_assert(MathUtils::popcount(0xF0F0U) == 8);
+    TS_ASSERT_EQUALS(MathUtils::popcount(0U), 0);
+    TS_ASSERT_EQUALS(MathUtils::popcount(UINT64_MAX), 64);
+    TS_ASSERT_EQUALS(MathUtils::popcount(static_cast<std::uint8_t>(0xFF)), 8);
+
+    TS_ASSERT(!MathUtils::isPow2(0U));
+    TS_ASSERT(MathUtils::isPow2(1U));
+    TS_ASSERT(MathUtils::isPow2(std::uint64_t(1) << 63));
+    TS_ASSERT(!MathUtils::isPow2(12U));
+
+    static_assert(MathUtils::ilog2(1024U) == 10);
+    TS_ASSERT_EQUALS(MathUtils::ilog2(0U), -1);
+    TS_ASSERT_EQUALS(MathUtils::ilog2(1U), 0);
+    TS_ASSERT_EQUALS(MathUtils::ilog2(1023U), 9);
+    TS_ASSERT_EQUALS(MathUtils::ilog2(static_cast<std::uint16_t>(0x8000)), 15);
+    TS_ASSERT_EQUALS(MathUtils::ilog2(UINT64_MAX), 63);
+
+    TS_ASSERT_EQUALS(MathUtils::ceilLog2(0U), 0);
+    TS_ASSERT_EQUALS(MathUtils::ceilLog2(1U), 0);
+    TS_ASSERT_EQUALS(MathUtils::ceilLog2(2U), 1);
+    TS_ASSERT_EQUALS(MathUtils::ceilLog2(1025U), 11);
+    TS_ASSERT_EQUALS(MathUtils::ceilLog2(UINT64_MAX), 64);
+
+    static_assert(MathUtils::nextPow2(100U) == 128U);
+    TS_ASSERT_EQUALS(MathUtils::nextPow2(0U), 1U);
+    TS_ASSERT_EQUALS(MathUtils::nextPow2(64U), 64U);
+    TS_ASSERT_EQUALS(MathUtils::nextPow2(0x80000000U), 0x80000000U);
+    TS_ASSERT_EQUALS(MathUtils::nextPow2(0x80000001U), 0U);
+    TS_ASSERT_EQUALS(MathUtils::nextPow2(static_cast<std::uint8_t>(200)), 0);
+  }
+
+  static void testAlign() {
+    static_assert(MathUtils::alignUp(100UL, 64) == 128UL);
+    TS_ASSERT_EQUALS(MathUtils::alignUp(0U, 16), 0U);
+    TS_ASSERT_EQUALS(MathUtils::alignUp(64U, 64), 64U);
+    TS_ASSERT_EQUALS(MathUtils::alignUp(65U, 1), 65U);
+    TS_ASSERT_EQUALS(MathUtils::alignUp(UINT32_MAX - 3, 4), UINT32_MAX - 3);
+    TS_ASSERT_EQUALS(MathUtils::alignUp(UINT32_MAX - 2, 4), 0U);
+    TS_ASSERT_EQUALS(MathUtils::alignDown(100U, 64), 64U);
+    TS_ASSERT_EQUALS(MathUtils::alignDown(63U, 64), 0U);
+
+    alignas(64) char buffer[128];
+    TS_ASSERT_EQUALS(MathUtils::alignUp(buffer + 1, 64), buffer + 64);
+    TS_ASSERT_EQUALS(MathUtils::alignUp(buffer + 64, 64), buffer + 64);
+    TS_ASSERT_EQUALS(MathUtils::alignDown(buffer + 127, 64), buffer + 64);
+    const auto* ints = reinterpret_cast<const int*>(buffer + 4);
+    TS_ASSERT_EQUALS(MathUtils::alignDown(ints, 16), reinterpret_cast<const int*>(buffer));
+  }
+
+  static void testMorton() {
+    TS_ASSERT_EQUALS(MathUtils::mortonEncode(1, 0), 1U);
+    TS_ASSERT_EQUALS(MathUtils::mortonEncode(0, 1), 2U);
+    TS_ASSERT_EQUALS(MathUtils::mortonEncode(3, 3), 15U);
+    TS_ASSERT_EQUALS(MathUtils::mortonEncode(UINT32_MAX, UINT32_MAX), UINT64_MAX);
+    TS_ASSERT_EQUALS(MathUtils::mortonEncode(0, 0, 1), 4U);
+    TS_ASSERT_EQUALS(MathUtils::mortonEncode(2, 0, 0), 8U);
+    TS_ASSERT_EQUALS(MathUtils::mortonEncode(0x1FFFFF, 0x1FFFFF, 0x1FFFFF), UINT64_MAX >> 1);
+
+    std::mt19937 random(42);
+    for (int i = 0; i < 1000; i++) {
+      const std::uint32_t x = random();
+      const std::uint32_t y = random();
+      const std::uint32_t z = random() & 0x1FFFFF;
+      const auto xy = MathUtils::mortonDecode2D(MathUtils::mortonEncode(x, y));
+      TS_ASSERT_EQUALS(xy[0], x);
+      TS_ASSERT_EQUALS(xy[1], y);
+      const auto xyz = MathUtils::mortonDecode3D(MathUtils::mortonEncode(x & 0x1FFFFF, y, z));
+      TS_ASSERT_EQUALS(xyz[0], x & 0x1FFFFF);
+      TS_ASSERT_EQUALS(xyz[1], y & 0x1FFFFF);
+      TS_ASSERT_EQUALS(xyz[2], z);
+    }
+  }
+
+  static void testHilbert() {
+    // Consecutive indices are neighbor cells
+    constexpr int Bits = 3;
+    constexpr std::uint32_t Size = 1U << Bits;
+    std::vector<std::array<std::uint32_t, 3>> cells(Size * Size * Size, {Size, Size, Size});
+    for (std::uint32_t x = 0; x < Size; x++) {
+      for (std::uint32_t y = 0; y < Size; y++) {
+        for (std::uint32_t z = 0; z < Size; z++) {
+          const std::uint64_t index = MathUtils::hilbertIndex(x, y, z, Bits);
+          TS_ASSERT(index < cells.size());
+          TS_ASSERT_EQUALS(cells[index][0], Size);
+          cells[index] = {x, y, z};
+        }
+      }
+    }
+    TS_ASSERT_EQUALS(cells[0][0] + cells[0][1] + cells[0][2], 0U);
+    for (std::size_t i = 1; i < cells.size(); i++) {
+      std::uint32_t distance = 0;
+      for (int d = 0; d < 3; d++) {
+        distance += std::max(cells[i][d], cells[i - 1][d]) - std::min(cells[i][d], cells[i - 1][d]);
+      }
+      TS_ASSERT_EQUALS(distance, 1U);
+    }
+  }
+
+  static void testSortPermutation() {
+    std::mt19937 random(1);
+    const std::size_t n = 10000;
+    std::vector<std::uint32_t> x(n);
+    std::vector<std::uint32_t> y(n);
+    std::vector<std::uint32_t> z(n);
+    for (std::size_t i = 0; i < n; i++) {
+      x[i] = random() % 1024;
+      y[i] = random() % 1024;
+      z[i] = random() % 16;
+    }
+
+    std::vector<std::uint64_t> codes(n);
+    MathUtils::mortonEncode(x.data(), y.data(), z.data(), codes.data(), n);
+    TS_ASSERT_EQUALS(codes[17], MathUtils::mortonEncode(x[17], y[17], z[17]));
+    MathUtils::hilbertIndex(x.data(), y.data(), z.data(), codes.data(), n, 10);
+    TS_ASSERT_EQUALS(codes[17], MathUtils::hilbertIndex(x[17], y[17], z[17], 10));
+
+    const std::vector<std::size_t> permutation = MathUtils::sortPermutation(codes.data(), n);
+    TS_ASSERT_EQUALS(permutation.size(), n);
+    std::vector<bool> seen(n);
+    for (std::size_t i = 0; i < n; i++) {
+      seen[permutation[i]] = true;
+      if (i > 0) {
+        TS_ASSERT(codes[permutation[i - 1]] <= codes[permutation[i]]);
+        if (codes[permutation[i - 1]] == codes[permutation[i]]) {
+          // Stable
+          TS_ASSERT(permutation[i - 1] < permutation[i]);
+        }
+      }
+    }
+    TS_ASSERT_EQUALS(std::count(seen.begin(), seen.end(), true), static_cast<long>(n));
+
+    TS_ASSERT(MathUtils::sortPermutation(codes.data(), 0).empty());
+  }
+
+  static void testBlockDistribution() {
+    static_assert(MathUtils::blockRange(10, 4, 1) == std::pair<int, int>(3, 6));
+    static_assert(MathUtils::blockOwner(10, 4, 6) == 2);
+
+    for (unsigned n = 0; n < 40; n++) {
+      for (unsigned parts = 1; parts < 12; parts++) {
+        unsigned expectedBegin = 0;
+        for (unsigned part = 0; part < parts; part++) {
+          const auto [begin, end] = MathUtils::blockRange(n, parts, part);
+          TS_ASSERT_EQUALS(begin, expectedBegin);
+          // Balanced
+          TS_ASSERT(end - begin == n / parts || end - begin == n / parts + 1);
+          for (unsigned i = begin; i < end; i++) {
+            TS_ASSERT_EQUALS(MathUtils::blockOwner(n, parts, i), part);
+          }
+          expectedBegin = end;
+        }
+        TS_ASSERT_EQUALS(expectedBegin, n);
+      }
+    }
+  }
+
+  static void testPartitionWeighted() {
+    const double costs[] = {1, 2, 3, 4, 5, 6, 7, 8, 9};
+    // Optimal: [1..5] [6, 7] [8, 9] with maximum 17
+    const std::vector<std::size_t> expected = {0, 5, 7, 9};
+    TS_ASSERT_EQUALS(MathUtils::partitionWeighted(costs, 9, 3), expected);
+    TS_ASSERT_EQUALS(MathUtils::partitionWeighted(costs, 0, 2), std::vector<std::size_t>(3, 0));
+
+    // Compare the bottleneck with a dynamic program
+    std::mt19937 random(3);
+    for (int test = 0; test < 200; test++) {
+      const std::size_t n = random() % 30;
+      const std::size_t parts = 1 + random() % 6;
+      std::vector<int> items(n);
+      for (auto& item : items) {
+        item = static_cast<int>(random() % 20);
+      }
+
+      const auto boundaries = MathUtils::partitionWeighted(items.data(), n, parts);
+      TS_ASSERT_EQUALS(boundaries.size(), parts + 1);
+      TS_ASSERT_EQUALS(boundaries.front(), 0U);
+      TS_ASSERT_EQUALS(boundaries.back(), n);
+      int bottleneck = 0;
+      for (std::size_t p = 0; p < parts; p++) {
+        TS_ASSERT(boundaries[p] <= boundaries[p + 1]);
+        bottleneck = std::max(bottleneck,
+                              std::accumulate(items.begin() + boundaries[p],
+                                              items.begin() + boundaries[p + 1],
+                                              0));
+      }
+
+      // best[k][i]: Minimal bottleneck of the first i items in k chunks
+      std::vector<std::vector<int>> best(parts + 1, std::vector<int>(n + 1, INT32_MAX));
+      best[0][0] = 0;
+      for (std::size_t k = 1; k <= parts; k++) {
+        for (std::size_t i = 0; i <= n; i++) {
+          int sum = 0;
+          for (std::size_t j = i + 1; j-- > 0;) {
+            if (best[k - 1][j] != INT32_MAX) {
+              best[k][i] = std::min(best[k][i], std::max(best[k - 1][j], sum));
+            }
+            if (j > 0) {
+              sum += items[j - 1];
+            }
+          }
+        }
+      }
+      TS_ASSERT_EQUALS(bottleneck, best[parts][n]);
+    }
+  }
+
+  static void testSum() {
+    // Naive summation gives 0 (every 1 is lost)
+    std::vector<double> values;
+    for (int i = 0; i < 1000; i++) {
+      values.insert(values.end(), {1e16, 1.0, -1e16});
+    }
+    TS_ASSERT_EQUALS(MathUtils::compensatedSum(values.data(), values.size()), 1000.0);
+    TS_ASSERT_EQUALS(MathUtils::parallelSum(values.data(), values.size()), 1000.0);
+
+    // Naive summation is off by about 1e-6
+    const std::vector<double> tenths(1000000, 0.1);
+    TS_ASSERT_DELTA(MathUtils::pairwiseSum(tenths.data(), tenths.size()), 100000.0, 1e-9);
+    TS_ASSERT_EQUALS(MathUtils::compensatedSum(tenths.data(), tenths.size()), 100000.0);
+
+    const std::vector<float> floats(100000, 0.1F);
+    TS_ASSERT_DELTA(MathUtils::pairwiseSum(floats.data(), floats.size()), 10000.0F, 0.01F);
+
+    const double small[] = {1, 2, 3};
+    TS_ASSERT_EQUALS(MathUtils::pairwiseSum(small, 3), 6.0);
+    TS_ASSERT_EQUALS(MathUtils::compensatedSum(small, 0), 0.0);
+    TS_ASSERT_EQUALS(MathUtils::parallelSum(small, 0), 0.0);
+  }
+
+  static void testDotAndNorms() {
+    const double a[] = {1, -2, 3, -4, 5, -6, 7, -8, 9, -10, 11};
+    const double b[] = {1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1};
+    TS_ASSERT_EQUALS(MathUtils::dot(a, b, 11), 6.0);
+    TS_ASSERT_EQUALS(MathUtils::compensatedDot(a, b, 11), 6.0);
+    TS_ASSERT_EQUALS(MathUtils::parallelDot(a, a, 11), 506.0);
+    TS_ASSERT_EQUALS(MathUtils::norm1(a, 11), 66.0);
+    TS_ASSERT_DELTA(MathUtils::norm2(a, 11), std::sqrt(506.0), 1e-12);
+    TS_ASSERT_EQUALS(MathUtils::normInf(a, 11), 11.0);
+    TS_ASSERT_EQUALS(MathUtils::normInf(a, 0), 0.0);
+  }
+
+  static void testParallelDeterministic() {
+    std::mt19937_64 random(7);
+    std::uniform_real_distribution<double> distribution(-1, 1);
+    std::vector<double> values(3 * (1 << 16) + 17);
+    for (auto& value : values) {
+      value = distribution(random) * std::exp(20 * distribution(random));
+    }
+
+    const double sum = MathUtils::parallelSum(values.data(), values.size(), 1);
+    const double dot = MathUtils::parallelDot(values.data(), values.data(), values.size(), 1);
+    for (unsigned int threads : {2U, 3U, 4U, 16U, 0U}) {
+      // Bitwise identical
+      TS_ASSERT_EQUALS(MathUtils::parallelSum(values.data(), values.size(), threads), sum);
+      TS_ASSERT_EQUALS(
+          MathUtils::parallelDot(values.data(), values.data(), values.size(), threads), dot);
+    }
+  }
 };
 #endif // UTILS_TESTS_MATHUTILS_T_H_
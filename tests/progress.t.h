@@ -9,12 +9,292 @@
 
 #include "utils/progress.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
 using namespace utils;
 
 class TestProgress : public CxxTest::TestSuite {
+  private:
+  /**
+   * Sets the output format for all progress bars created afterwards
+   */
+  static void setFormat(const char* format) {
+    setenv("UTILS_PROGRESS_FORMAT", format, 1);
+    Env::refresh();
+  }
+
   public:
   void testFoo() {
     // TODO
   }
+
+  static void testUpdate() {
+    setFormat("BAR");
+    std::ostringstream out;
+    std::streambuf* cerr = std::cerr.rdbuf(out.rdbuf());
+
+    Progress progress(200);
+    progress.update(50);
+    progress.increment();
+    std::cerr.rdbuf(cerr);
+
+    TS_ASSERT_EQUALS(out.str().substr(0, 6), " 25% [");
+    TS_ASSERT_DIFFERS(out.str().find("\r 25% ["), std::string::npos);
+  }
+
+  static void testSkipUnchanged() {
+    setFormat("BAR");
+    setenv("UTILS_PROGRESS_SIZE", "29", 1);
+    Env::refresh();
+    std::ostringstream out;
+    std::streambuf* cerr = std::cerr.rdbuf(out.rdbuf());
+
+    Progress progress(1000000);
+    for (unsigned long i = 0; i < 1000000; i++) {
+      progress.update(i);
+    }
+    std::cerr.rdbuf(cerr);
+    unsetenv("UTILS_PROGRESS_SIZE");
+    Env::refresh();
+
+    // One line per percent (unless the rotation indicator moved)
+    const std::string output = out.str();
+    const auto lines = std::count(output.begin(), output.end(), '\r');
+    TS_ASSERT(lines >= 100);
+    TS_ASSERT(lines < 1000);
+    TS_ASSERT_EQUALS(output.substr(0, 28), "  0% [                    ] ");
+    TS_ASSERT_EQUALS(output.substr(output.size() - 30, 28), " 99% [=================== ] ");
+  }
+
+  static void testConcurrent() {
+    setFormat("BAR");
+    std::ostringstream out;
+    std::streambuf* cerr = std::cerr.rdbuf(out.rdbuf());
+
+    {
+      Progress progress(1000);
+      progress.start(std::chrono::milliseconds(1));
+
+      std::vector<std::thread> threads;
+      for (int t = 0; t < 4; t++) {
+        threads.emplace_back([&progress]() {
+          for (int i = 0; i < 250; i++) {
+            progress.increment();
+          }
+        });
+      }
+      // Can be changed while the renderer is running
+      progress.setFields(Progress::ELAPSED);
+      progress.setInterval(1);
+      for (auto& thread : threads) {
+        thread.join();
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+      // The destructor stops the renderer
+    }
+    std::cerr.rdbuf(cerr);
+
+    const std::string output = out.str();
+    TS_ASSERT(output.size() > 2);
+    TS_ASSERT_EQUALS(output.back(), '\n');
+    const std::size_t last = output.rfind('\r', output.size() - 3);
+    const std::size_t start = last == std::string::npos ? 0 : last + 1;
+    TS_ASSERT_EQUALS(output.substr(start, 6), "100% [");
+  }
+
+  static void testRateEstimator() {
+    const auto start = RateEstimator::Clock::now();
+    RateEstimator rate(1);
+    rate.reset(start, 0);
+    TS_ASSERT(!rate.valid());
+
+    rate.sample(start + std::chrono::seconds(1), 100);
+    TS_ASSERT(rate.valid());
+    TS_ASSERT_DELTA(rate.rate(), 100, 1e-9);
+
+    // Long gaps give more weight to the new rate
+    rate.sample(start + std::chrono::seconds(2), 300);
+    const double afterShort = rate.rate();
+    TS_ASSERT(afterShort > 100 && afterShort < 200);
+    rate.sample(start + std::chrono::seconds(12), 300);
+    TS_ASSERT(rate.rate() < 1);
+
+    // A smaller count starts a new estimate
+    rate.sample(start + std::chrono::seconds(13), 10);
+    TS_ASSERT(!rate.valid());
+  }
+
+  static void testFields() {
+    setFormat("BAR");
+    std::ostringstream out;
+    std::streambuf* cerr = std::cerr.rdbuf(out.rdbuf());
+
+    Progress progress(100);
+    progress.setFields(Progress::ELAPSED | Progress::RATE | Progress::ETA);
+    progress.update(10);
+    progress.setTotal(10);
+    progress.update(10);
+    std::cerr.rdbuf(cerr);
+
+    const std::string output = out.str();
+    const std::size_t second = output.find('\r') + 1;
+    // The width of the line does not change
+    TS_ASSERT_EQUALS(output.find('\r', second), output.size() - 1);
+    TS_ASSERT_EQUALS(second, output.size() - second);
+    TS_ASSERT_DIFFERS(output.find("ETA    00:00\r", second), std::string::npos);
+    TS_ASSERT_EQUALS(output.substr(second, 6), "100% [");
+  }
+
+  static void testFinalOnce() {
+    setFormat("BAR");
+    std::ostringstream out;
+    std::streambuf* cerr = std::cerr.rdbuf(out.rdbuf());
+
+    Progress progress(10);
+    progress.update(10);
+    progress.update(10);
+    progress.increment();
+    const std::string final = out.str();
+    // Drawn again once the progress is no longer complete
+    progress.update(5);
+    std::cerr.rdbuf(cerr);
+
+    TS_ASSERT_EQUALS(std::count(final.begin(), final.end(), '\r'), 1);
+    TS_ASSERT_EQUALS(final.substr(0, 6), "100% [");
+    TS_ASSERT_EQUALS(out.str().substr(final.size(), 6), " 50% [");
+  }
+
+  static void testLine() {
+    setFormat("LINE");
+    std::ostringstream out;
+    std::streambuf* cerr = std::cerr.rdbuf(out.rdbuf());
+
+    Progress progress(200);
+    progress.setInterval(1000, 25);
+    for (unsigned long i = 0; i < 150; i++) {
+      progress.update(i);
+    }
+    // The final state is always written
+    progress.setTotal(150);
+    progress.update(150);
+    progress.update();
+    std::cerr.rdbuf(cerr);
+
+    const std::vector<std::string> lines = StringUtils::split(out.str(), '\n');
+    TS_ASSERT_EQUALS(lines.size(), 4U);
+    TS_ASSERT(StringUtils::startsWith(lines[0], "0.0% 0/200 elapsed 00:00"));
+    TS_ASSERT(StringUtils::startsWith(lines[2], "50.0% 100/200 "));
+    TS_ASSERT(StringUtils::startsWith(lines[3], "100.0% 150/150 "));
+    TS_ASSERT(StringUtils::endsWith(lines[3], " eta 00:00"));
+    TS_ASSERT_EQUALS(out.str().find('\r'), std::string::npos);
+  }
+
+  static void testJson() {
+    setFormat("JSON");
+    std::ostringstream out;
+    std::streambuf* cerr = std::cerr.rdbuf(out.rdbuf());
+
+    {
+      Progress progress(4);
+      progress.setInterval(1000, 50);
+      progress.start(std::chrono::milliseconds(1));
+      for (int i = 0; i < 4; i++) {
+        progress.increment();
+      }
+    }
+    std::cerr.rdbuf(cerr);
+    setFormat("AUTO");
+
+    const std::vector<std::string> lines = StringUtils::split(out.str(), '\n');
+    TS_ASSERT(!lines.empty());
+    TS_ASSERT(StringUtils::startsWith(lines.back(), "{\"percent\":100.0,\"count\":4,\"total\":4,"));
+    TS_ASSERT(StringUtils::endsWith(lines.back(), ",\"eta\":0.000}"));
+  }
+
+  static void testMultiBar() {
+    setFormat("BAR");
+    setenv("UTILS_PROGRESS_SIZE", "41", 1);
+    Env::refresh();
+    std::ostringstream out;
+    std::streambuf* cerr = std::cerr.rdbuf(out.rdbuf());
+
+    {
+      MultiProgress progress;
+      const auto step = progress.addTask("step", 2);
+      const auto compute = progress.addTask("compute", 6, step);
+      const auto output = progress.addTask("output", 2, step);
+      progress.set(step, 1);
+      progress.set(compute, 3);
+      progress.update();
+
+      progress.finish(compute);
+      progress.remove(output);
+      progress.update();
+    }
+    std::cerr.rdbuf(cerr);
+    unsetenv("UTILS_PROGRESS_SIZE");
+    Env::refresh();
+
+    const std::vector<std::string> lines = StringUtils::split(out.str(), '\n');
+    TS_ASSERT_EQUALS(lines.size(), 8U);
+    // Children are indented and roll up into their parent ((1 + 0.5 + 0) / (2 + 2) = 37.5%)
+    TS_ASSERT_EQUALS(lines[0], "\rstep       37% [=======            ] 1/2\x1b[K");
+    TS_ASSERT_EQUALS(lines[1], "  compute  50% [=========          ] 3/6\x1b[K");
+    TS_ASSERT_EQUALS(lines[2], "  output    0% [                   ] 0/2\x1b[K");
+    // The cursor moves back to the first line; removed tasks disappear
+    TS_ASSERT_EQUALS(lines[3], "\x1b[J\x1b[3A\rstep       66% [============       ] 1/2\x1b[K");
+    TS_ASSERT_EQUALS(lines[4], "  compute 100% [===================] 6/6\x1b[K");
+    // The destructor draws the final state
+    TS_ASSERT(StringUtils::startsWith(lines[5], "\x1b[J\x1b[2A\rstep"));
+    TS_ASSERT_EQUALS(lines[7], "\x1b[J");
+  }
+
+  static void testMultiLine() {
+    setFormat("LINE");
+    std::ostringstream out;
+    std::streambuf* cerr = std::cerr.rdbuf(out.rdbuf());
+
+    {
+      MultiProgress progress;
+      const auto step = progress.addTask("step", 10);
+      const auto compute = progress.addTask("compute", 100, step);
+      progress.set(step, 3);
+      progress.add(compute, 45);
+      // Within the interval, only the final state is written
+    }
+    std::cerr.rdbuf(cerr);
+    setFormat("AUTO");
+
+    TS_ASSERT_EQUALS(out.str(), "step 3/10 31.4% | step/compute 45/100 45.0%\n");
+  }
+
+  static void testMultiFractions() {
+    setFormat("LINE");
+    std::ostringstream out;
+    std::streambuf* cerr = std::cerr.rdbuf(out.rdbuf());
+
+    {
+      MultiProgress progress;
+      const auto setup = progress.addTask("setup", 0);
+      const auto mesh = progress.addTask("mesh", 1000000, setup);
+      progress.addTask("io", 2, setup);
+      progress.addTask("check", 4, setup, 2);
+      progress.finish(mesh);
+      // The small total of io and check is not outweighed by the large total of mesh
+    }
+    std::cerr.rdbuf(cerr);
+    setFormat("AUTO");
+
+    TS_ASSERT_EQUALS(out.str(),
+                     "setup 0/0 25.0% | setup/mesh 1000000/1000000 100.0% | setup/io 0/2 0.0% | "
+                     "setup/check 0/4 0.0%\n");
+  }
 };
 #endif // UTILS_TESTS_PROGRESS_T_H_
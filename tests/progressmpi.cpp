@@ -0,0 +1,66 @@
+// SPDX-FileCopyrightText: 2024 Technical University of Munich
+//
+// SPDX-License-Identifier: BSD-3-Clause
+
+// Tests the distributed mode of Progress (run with at least 2 ranks)
+
+#include <mpi.h>
+
+#include "utils/progress.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace utils;
+
+auto main(int argc, char** argv) -> int {
+  MPI_Init(&argc, &argv);
+  int rank = 0;
+  int size = 0;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  setenv("UTILS_PROGRESS_FORMAT", "LINE", 1);
+  Env::refresh();
+
+  std::ostringstream out;
+  std::streambuf* cerr = std::cerr.rdbuf(out.rdbuf());
+
+  // Rank r counts to 10 * (r + 1)
+  const unsigned long total = 10 * (rank + 1);
+  Progress progress(total);
+  progress.setDistributed(MPI_COMM_WORLD);
+  for (unsigned long i = 1; i <= total; i++) {
+    progress.update(i);
+  }
+  progress.stop();
+
+  std::cerr.rdbuf(cerr);
+
+  int failed = 0;
+  const std::string output = out.str();
+  if (rank == 0) {
+    const std::vector<std::string> lines = StringUtils::split(output, '\n');
+    const unsigned long globalTotal = 5UL * size * (size + 1);
+    const std::string expected =
+        "100.0% " + std::to_string(globalTotal) + "/" + std::to_string(globalTotal) + " ";
+    // Only the final record contains the summed totals of all ranks
+    if (lines.empty() || !StringUtils::startsWith(lines.back(), expected)) {
+      std::cout << "Rank 0: expected a final record starting with \"" << expected
+                << "\", got:\n"
+                << output << std::endl;
+      failed = 1;
+    }
+  } else if (!output.empty()) {
+    std::cout << "Rank " << rank << " printed:\n" << output << std::endl;
+    failed = 1;
+  }
+
+  int anyFailed = 0;
+  MPI_Allreduce(&failed, &anyFailed, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+  MPI_Finalize();
+  return anyFailed;
+}
@@ -0,0 +1,52 @@
+// SPDX-FileCopyrightText: 2024 Technical University of Munich
+//
+// SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef UTILS_TESTS_STRINGBUILDER_T_H_
+#define UTILS_TESTS_STRINGBUILDER_T_H_
+
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <memory_resource>
+
+#include "utils/stringbuilder.h"
+
+using namespace utils;
+
+class TestStringBuilder : public CxxTest::TestSuite {
+  public:
+  static void testAppend() {
+    StringBuilder builder;
+    builder.append("rank").append('-').appendPadLeft("7", 4, '0').append('.', 3);
+    TS_ASSERT_EQUALS(builder.view(), "rank-0007...");
+
+    builder.clear();
+    builder.appendPadRight("ab", 4, ' ').append('|');
+    TS_ASSERT_EQUALS(builder.str(), "ab  |");
+  }
+
+  static void testAppendNumber() {
+    StringBuilder builder;
+    builder.appendNumber(-42).append(' ').appendNumber(std::numeric_limits<std::uint64_t>::max());
+    builder.append(' ').appendNumber(0.1);
+    builder.append(' ').appendNumber(2.5, std::chars_format::fixed, 3);
+    TS_ASSERT_EQUALS(builder.view(), "-42 18446744073709551615 0.1 2.500");
+
+    builder.clear();
+    builder.appendNumber(1e300, std::chars_format::fixed, 2);
+    TS_ASSERT_EQUALS(builder.size(), 304);
+  }
+
+  static void testArena() {
+    std::array<char, 256> memory{};
+    std::pmr::monotonic_buffer_resource arena(memory.data(), memory.size());
+
+    ArenaStringBuilder builder(&arena);
+    builder.reserve(64).append("step ").appendNumber(12);
+    TS_ASSERT_EQUALS(builder.view(), "step 12");
+    TS_ASSERT(builder.view().data() >= memory.data());
+    TS_ASSERT(builder.view().data() < memory.data() + memory.size());
+  }
+};
+#endif // UTILS_TESTS_STRINGBUILDER_T_H_
@@ -0,0 +1,59 @@
+// SPDX-FileCopyrightText: 2024 Technical University of Munich
+//
+// SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef UTILS_TESTS_STRINGPOOL_T_H_
+#define UTILS_TESTS_STRINGPOOL_T_H_
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "utils/stringpool.h"
+
+using namespace utils;
+
+class TestStringPool : public CxxTest::TestSuite {
+  public:
+  static void testIntern() {
+    StringPool pool;
+    const InternedString empty;
+    TS_ASSERT_EQUALS(pool.intern(""), empty);
+    TS_ASSERT_EQUALS(std::string(empty.c_str()), "");
+
+    const InternedString a = pool.intern("alpha");
+    const InternedString b = pool.intern(std::string("beta"));
+    TS_ASSERT_DIFFERS(a, b);
+    TS_ASSERT_EQUALS(pool.intern(std::string_view("alphabet", 5)), a);
+    TS_ASSERT_EQUALS(a.view(), "alpha");
+    TS_ASSERT_EQUALS(std::string(a.c_str()), "alpha");
+    TS_ASSERT_EQUALS(pool.get(b.id()).view(), "beta");
+    TS_ASSERT_EQUALS(pool.size(), 3);
+
+    TS_ASSERT(pool.find("alpha").has_value());
+    TS_ASSERT(!pool.find("gamma").has_value());
+    TS_ASSERT_EQUALS(pool.size(), 3);
+  }
+
+  static void testConcurrent() {
+    StringPool pool;
+    std::vector<std::thread> threads;
+    std::vector<std::vector<std::uint32_t>> ids(4);
+    for (std::size_t t = 0; t < ids.size(); t++) {
+      threads.emplace_back([&pool, &ids, t]() {
+        for (int i = 0; i < 1000; i++) {
+          ids[t].push_back(pool.intern("key" + std::to_string(i)).id());
+        }
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+
+    TS_ASSERT_EQUALS(pool.size(), 1001);
+    for (std::size_t t = 1; t < ids.size(); t++) {
+      TS_ASSERT(ids[t] == ids[0]);
+    }
+  }
+};
+#endif // UTILS_TESTS_STRINGPOOL_T_H_
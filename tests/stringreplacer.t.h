@@ -0,0 +1,62 @@
+// SPDX-FileCopyrightText: 2024 Technical University of Munich
+//
+// SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef UTILS_TESTS_STRINGREPLACER_T_H_
+#define UTILS_TESTS_STRINGREPLACER_T_H_
+
+#include "utils/stringreplacer.h"
+#include "allocationcounter.h"
+
+using namespace utils;
+
+class TestStringReplacer : public CxxTest::TestSuite {
+  public:
+  static void testReplace() {
+    const StringReplacer replacer({{"{rank}", "3"}, {"{step}", "0042"}, {"{name}", "wave"}});
+
+    TS_ASSERT_EQUALS(replacer.replace("{name}-{rank}-{step}.h5"), "wave-3-0042.h5");
+    TS_ASSERT_EQUALS(replacer.replace("{rank}{rank}"), "33");
+    TS_ASSERT_EQUALS(replacer.replace("{ran{rank}}"), "{ran3}");
+    TS_ASSERT_EQUALS(replacer.replace("nothing"), "nothing");
+    TS_ASSERT_EQUALS(replacer.replace(""), "");
+
+    std::string out = "old content";
+    replacer.replace("{step}", out);
+    TS_ASSERT_EQUALS(out, "0042");
+  }
+
+  static void testLeftmostLongest() {
+    const StringReplacer replacer({{"bcd", "1"}, {"abcde", "2"}, {"ab", "3"}, {"e", "4"}});
+
+    TS_ASSERT_EQUALS(replacer.replace("abcde"), "2");
+    TS_ASSERT_EQUALS(replacer.replace("abcdf"), "3cdf");
+    TS_ASSERT_EQUALS(replacer.replace("xbcde"), "x14");
+    TS_ASSERT_EQUALS(replacer.replace("aabcdx"), "a3cdx");
+  }
+
+  static void testOverride() {
+    const StringReplacer replacer({{"a", "b"}, {"", "x"}, {"a", "c"}});
+
+    TS_ASSERT_EQUALS(replacer.size(), 1);
+    TS_ASSERT_EQUALS(replacer.replace("aba"), "cbc");
+  }
+
+  static void testSingleAllocation() {
+    const StringReplacer replacer({{"{r}", "rank"}, {"{s}", "step-"}, {"long", "x"}});
+
+    std::string input;
+    std::string expected;
+    for (int i = 0; i < 1000; i++) {
+      input += "{r}-{s}{s}long";
+      expected += "rank-step-step-x";
+    }
+
+    std::string out;
+    const tests::AllocationCounter counter;
+    replacer.replace(input, out);
+    TS_ASSERT_EQUALS(counter.count(), 1);
+    TS_ASSERT_EQUALS(out, expected);
+  }
+};
+#endif // UTILS_TESTS_STRINGREPLACER_T_H_
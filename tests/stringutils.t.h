@@ -23,6 +23,45 @@ class TestStringUtils : public CxxTest::TestSuite {
     TS_ASSERT(!StringUtils::endsWith("abcde", "abc"));
   }
 
+  static void testCaseConversion() {
+    std::string str = "Hello, World! 0123456789 [abcxyz] {ABCXYZ} @`\xe4";
+    StringUtils::toUpperAscii(str);
+    TS_ASSERT_EQUALS(str, "HELLO, WORLD! 0123456789 [ABCXYZ] {ABCXYZ} @`\xe4");
+    StringUtils::toLowerAscii(str);
+    TS_ASSERT_EQUALS(str, "hello, world! 0123456789 [abcxyz] {abcxyz} @`\xe4");
+
+    TS_ASSERT(StringUtils::equalsIgnoreCase("StdErr", "STDERR"));
+    TS_ASSERT(!StringUtils::equalsIgnoreCase("STDERR", "STDOUT"));
+    TS_ASSERT(!StringUtils::equalsIgnoreCase("[", "{"));
+  }
+
+  static void testTrim() {
+    TS_ASSERT_EQUALS(StringUtils::trimView(" \t abc\r\n"), "abc");
+    TS_ASSERT_EQUALS(StringUtils::trimView("   "), "");
+    TS_ASSERT_EQUALS(StringUtils::ltrimView("\v\f a b "), "a b ");
+    TS_ASSERT_EQUALS(StringUtils::rtrimView("                  a b                   "),
+                     "                  a b");
+
+    std::string str = "                    long string with spaces                    ";
+    TS_ASSERT_EQUALS(StringUtils::trim(str), "long string with spaces");
+  }
+
+  static void testPad() {
+    TS_ASSERT_EQUALS(StringUtils::padLeft("7", 3, '0'), "007");
+    TS_ASSERT_EQUALS(StringUtils::padLeft("1234", 3, '0'), "1234");
+    TS_ASSERT_EQUALS(StringUtils::padRight("ab", 5, '.'), "ab...");
+    TS_ASSERT_EQUALS(StringUtils::padRight("abc", 0, '.'), "abc");
+  }
+
+  static void testJoin() {
+    TS_ASSERT_EQUALS(StringUtils::join(std::vector<std::string>{"a", "bc", ""}, ", "), "a, bc, ");
+    TS_ASSERT_EQUALS(StringUtils::join(std::vector<std::string>(), ","), "");
+    TS_ASSERT_EQUALS(StringUtils::join(std::vector<int>{1, -2, 3}, "|"), "1|-2|3");
+    TS_ASSERT_EQUALS(StringUtils::join(std::vector<double>{0.5, 1.0 / 3, 1e20}, " "),
+                     "0.5 0.333333 1e+20");
+    TS_ASSERT_EQUALS(StringUtils::join(std::vector<char>{'a', 'b'}, ""), "ab");
+  }
+
   static void testParse() {
     // Normal parser
     // TODO more tests
@@ -32,6 +71,7 @@ class TestStringUtils : public CxxTest::TestSuite {
     TS_ASSERT(StringUtils::parse<bool>("on"));
     TS_ASSERT(StringUtils::parse<bool>("yes"));
     TS_ASSERT(StringUtils::parse<bool>("on"));
+    TS_ASSERT(StringUtils::parse<bool>(" TRUE\n"));
     TS_ASSERT(!StringUtils::parse<bool>("off"));
     TS_ASSERT(!StringUtils::parse<bool>("abc"));
   }
@@ -44,5 +84,28 @@ class TestStringUtils : public CxxTest::TestSuite {
     TS_ASSERT_EQUALS(result[1], 2);
     TS_ASSERT_EQUALS(result[2], 3);
   }
+
+  static void testParseNumber() {
+    int i = 5;
+    TS_ASSERT(StringUtils::parseNumber(" +42 ", i));
+    TS_ASSERT_EQUALS(i, 42);
+    TS_ASSERT(StringUtils::parseNumber("-7", i));
+    TS_ASSERT_EQUALS(i, -7);
+    TS_ASSERT(!StringUtils::parseNumber("12abc", i));
+    TS_ASSERT(!StringUtils::parseNumber("", i));
+    TS_ASSERT(!StringUtils::parseNumber("+-1", i));
+    TS_ASSERT(!StringUtils::parseNumber("99999999999", i));
+    TS_ASSERT_EQUALS(i, -7);
+
+    unsigned char c = 0;
+    TS_ASSERT(!StringUtils::parseNumber("-1", c));
+
+    double d = 0;
+    TS_ASSERT(StringUtils::parseNumber("1.5e3", d));
+    TS_ASSERT_DELTA(d, 1500, 1e-12);
+    TS_ASSERT(StringUtils::parseNumber(std::string_view("0.25,1").substr(0, 4), d));
+    TS_ASSERT_DELTA(d, 0.25, 1e-15);
+    TS_ASSERT(!StringUtils::parseNumber("1.5.", d));
+  }
 };
 #endif // UTILS_TESTS_STRINGUTILS_T_H_
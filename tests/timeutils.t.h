@@ -9,6 +9,8 @@
 
 #include "utils/timeutils.h"
 
+#include <limits>
+
 using namespace utils;
 
 class TestTimeUtils : public CxxTest::TestSuite {
@@ -16,5 +18,14 @@ class TestTimeUtils : public CxxTest::TestSuite {
   void testFoo() {
     // TODO
   }
+
+  static void testDurationAsString() {
+    TS_ASSERT_EQUALS(TimeUtils::durationAsString(0), "00:00");
+    TS_ASSERT_EQUALS(TimeUtils::durationAsString(59.9), "00:59");
+    TS_ASSERT_EQUALS(TimeUtils::durationAsString(754), "12:34");
+    TS_ASSERT_EQUALS(TimeUtils::durationAsString(3600 * 27 + 61), "27:01:01");
+    TS_ASSERT_EQUALS(TimeUtils::durationAsString(-1), "--:--");
+    TS_ASSERT_EQUALS(TimeUtils::durationAsString(std::numeric_limits<double>::infinity()), "--:--");
+  }
 };
 #endif // UTILS_TESTS_TIMEUTILS_T_H_
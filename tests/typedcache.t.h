@@ -0,0 +1,48 @@
+// SPDX-FileCopyrightText: 2024 Technical University of Munich
+//
+// SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef UTILS_TESTS_TYPEDCACHE_T_H_
+#define UTILS_TESTS_TYPEDCACHE_T_H_
+
+#include <stdexcept>
+#include <string>
+
+#include "utils/typedcache.h"
+
+using namespace utils;
+
+class TestTypedCache : public CxxTest::TestSuite {
+  public:
+  static void testGet() {
+    TypedCache cache;
+    int calls = 0;
+    const auto compute = [&calls]() {
+      ++calls;
+      return 42;
+    };
+
+    const InternedString name = intern("value");
+    TS_ASSERT_EQUALS(cache.get<int>(name, compute), 42);
+    TS_ASSERT_EQUALS(cache.get<int>(name, compute), 42);
+    TS_ASSERT_EQUALS(calls, 1);
+
+    TS_ASSERT_EQUALS(cache.get<std::string>(name, []() { return std::string("42"); }), "42");
+    TS_ASSERT_EQUALS(cache.size(), 2);
+
+    TS_ASSERT_THROWS(cache.get<double>(name, []() -> double { throw std::out_of_range(""); }),
+                     std::out_of_range);
+    TS_ASSERT_EQUALS(cache.size(), 2);
+
+    cache.clear();
+    TS_ASSERT_EQUALS(cache.get<int>(name, compute), 42);
+    TS_ASSERT_EQUALS(calls, 2);
+  }
+
+  static void testBinding() {
+    const Binding<std::string> binding("abc");
+    TS_ASSERT_EQUALS(*binding, "abc");
+    TS_ASSERT_EQUALS(binding->size(), 3);
+  }
+};
+#endif // UTILS_TESTS_TYPEDCACHE_T_H_
@@ -7,7 +7,10 @@
 #ifndef UTILS_TIMEUTILS_H_
 #define UTILS_TIMEUTILS_H_
 
+#include <cmath>
 #include <ctime>
+#include <iomanip>
+#include <sstream>
 #include <string>
 
 /**
@@ -51,6 +54,26 @@ class TimeUtils {
   static auto timeAsString(const std::string& formatString) -> std::string {
     return timeAsString(formatString, time(nullptr));
   }
+
+  /**
+   * Formats a duration as MM:SS or H:MM:SS (if longer than one hour)
+   *
+   * @return "--:--" if the duration is negative or not finite
+   */
+  static auto durationAsString(double seconds) -> std::string {
+    if (!std::isfinite(seconds) || seconds < 0) {
+      return "--:--";
+    }
+
+    const auto total = static_cast<unsigned long long>(seconds);
+    std::ostringstream ss;
+    ss << std::setfill('0');
+    if (total >= 3600) {
+      ss << total / 3600 << ':';
+    }
+    ss << std::setw(2) << (total / 60) % 60 << ':' << std::setw(2) << total % 60;
+    return ss.str();
+  }
 };
 
 } // namespace utils
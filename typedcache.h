@@ -0,0 +1,89 @@
+// SPDX-FileCopyrightText: 2024 Technical University of Munich
+//
+// SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef UTILS_TYPEDCACHE_H_
+#define UTILS_TYPEDCACHE_H_
+
+#include "utils/stringpool.h"
+
+#include <any>
+#include <cstddef>
+#include <functional>
+#include <typeindex>
+#include <typeinfo>
+#include <unordered_map>
+#include <utility>
+
+namespace utils {
+
+/**
+ * Stores parsed values keyed by name and type
+ *
+ * Used by Env and Args to avoid parsing the same string again on every
+ * access. References to cached values stay valid until clear() is called.
+ */
+class TypedCache {
+  private:
+  struct Key {
+    InternedString name;
+    std::type_index type;
+
+    auto operator==(const Key& other) const -> bool {
+      return name == other.name && type == other.type;
+    }
+  };
+
+  struct KeyHash {
+    auto operator()(const Key& key) const noexcept -> std::size_t {
+      return std::hash<InternedString>()(key.name) * 31 + key.type.hash_code();
+    }
+  };
+
+  std::unordered_map<Key, std::any, KeyHash> m_values;
+
+  public:
+  /**
+   * @param compute Function that returns the value if it is not cached yet.
+   *  If it throws, nothing is cached.
+   * @return The cached value for name and type T
+   */
+  template <typename T, typename F>
+  auto get(InternedString name, F&& compute) -> const T& {
+    const Key key{name, std::type_index(typeid(T))};
+    auto it = m_values.find(key);
+    if (it == m_values.end()) {
+      it = m_values.emplace(key, std::make_any<T>(std::forward<F>(compute)())).first;
+    }
+    return *std::any_cast<T>(&it->second);
+  }
+
+  void clear() { m_values.clear(); }
+
+  [[nodiscard]] auto size() const -> std::size_t { return m_values.size(); }
+};
+
+/**
+ * A configuration value that is resolved once
+ *
+ * Returned by Env::bind() and Args::bind(). Reading the value is a plain
+ * member access, which makes bindings suitable for inner loops.
+ */
+template <typename T>
+class Binding {
+  private:
+  T m_value;
+
+  public:
+  explicit Binding(T value) : m_value(std::move(value)) {}
+
+  auto operator*() const -> const T& { return m_value; }
+
+  auto operator->() const -> const T* { return &m_value; }
+
+  [[nodiscard]] auto get() const -> const T& { return m_value; }
+};
+
+} // namespace utils
+
+#endif // UTILS_TYPEDCACHE_H_